@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "util.h"
 
 class AbstractTexture : private NonCopyable
 {
@@ -8,4 +9,12 @@ public:
     virtual ~AbstractTexture() = default;
 
     virtual void bind() const = 0;
+
+    // Called for every sprite that samples `texRect` (in pixels), before it's drawn. Textures that upload lazily make
+    // sure the rect is uploaded by then.
+    virtual void prepareSampling(const RectF &texRect) const {}
+
+    // in pixels, texture coordinates of PackedPixmap and SpriteBatcher are in pixels too
+    virtual int width() const = 0;
+    virtual int height() const = 0;
 };
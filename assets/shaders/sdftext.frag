@@ -0,0 +1,21 @@
+#version 100
+#extension GL_OES_standard_derivatives : enable
+
+precision highp float;
+
+uniform sampler2D baseColorTexture;
+
+varying vec2 vs_texCoord;
+varying vec4 vs_color;
+varying vec4 vs_channelMask;
+
+void main(void)
+{
+    // the distance field is 0.5 on the outline, see Font::SdfPadding
+    float distance = dot(texture2D(baseColorTexture, vs_texCoord), vs_channelMask);
+    float feather = 0.7 * fwidth(distance);
+    float alpha = smoothstep(0.5 - feather, 0.5 + feather, distance);
+    vec4 color = vs_color;
+    color.a *= alpha;
+    gl_FragColor = color;
+}
@@ -6,10 +6,11 @@ uniform sampler2D baseColorTexture;
 
 varying vec2 vs_texCoord;
 varying vec4 vs_color;
+varying vec4 vs_channelMask;
 
 void main(void)
 {
-    float alpha = texture2D(baseColorTexture, vs_texCoord).r;
+    float alpha = dot(texture2D(baseColorTexture, vs_texCoord), vs_channelMask);
     vec4 color = vs_color;
     color.a *= alpha;
     gl_FragColor = color;
@@ -3,15 +3,19 @@
 attribute vec2 position;
 attribute vec2 texCoord;
 attribute vec4 color;
+attribute float channel;
 
 uniform mat4 mvp;
 
 varying vec2 vs_texCoord;
 varying vec4 vs_color;
+varying vec4 vs_channelMask;
 
 void main(void)
 {
     vs_texCoord = texCoord;
     vs_color = color;
+    // which texture channel holds the glyph, for channel-packed atlases (grayscale textures read as r)
+    vs_channelMask = vec4(equal(vec4(channel), vec4(0.0, 1.0, 2.0, 3.0)));
     gl_Position = mvp * vec4(position, 0.0, 1.0);
 }
@@ -0,0 +1,341 @@
+#include "atlascache.h"
+
+#include "fontcache.h"
+#include "ioutil.h"
+#include "log.h"
+#include "pixmap.h"
+#include "pixmapcache.h"
+#include "textureatlas.h"
+#include "trace.h"
+
+#include <cassert>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <span>
+
+namespace AtlasCache
+{
+
+namespace
+{
+constexpr std::uint32_t Magic = 0x4142524f; // "ORBA"
+constexpr std::uint32_t Version = 5;
+
+class Writer
+{
+public:
+    explicit Writer(std::FILE *file)
+        : m_file(file)
+    {
+    }
+
+    template<typename T>
+    void write(const T &value)
+    {
+        std::fwrite(&value, sizeof(T), 1, m_file);
+    }
+
+    void write(const std::string &value)
+    {
+        write(static_cast<std::uint32_t>(value.size()));
+        std::fwrite(value.data(), 1, value.size(), m_file);
+    }
+
+    void write(std::span<const unsigned char> data) { std::fwrite(data.data(), 1, data.size(), m_file); }
+
+    bool ok() const { return !std::ferror(m_file); }
+
+private:
+    std::FILE *m_file;
+};
+
+class Reader
+{
+public:
+    explicit Reader(std::span<const unsigned char> data)
+        : m_data(data)
+    {
+    }
+
+    template<typename T>
+    bool read(T &value)
+    {
+        if (m_offset + sizeof(T) > m_data.size())
+            return false;
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    bool read(std::string &value)
+    {
+        std::uint32_t size;
+        if (!read(size) || m_offset + size > m_data.size())
+            return false;
+        value.assign(reinterpret_cast<const char *>(m_data.data()) + m_offset, size);
+        m_offset += size;
+        return true;
+    }
+
+    bool read(std::span<unsigned char> data)
+    {
+        if (m_offset + data.size() > m_data.size())
+            return false;
+        std::memcpy(data.data(), m_data.data() + m_offset, data.size());
+        m_offset += data.size();
+        return true;
+    }
+
+private:
+    std::span<const unsigned char> m_data;
+    std::size_t m_offset = 0;
+};
+
+// Placements are stored as a page index and a rect in pixels.
+void writePlacement(Writer &writer, const TextureAtlas &atlas, const PackedPixmap &pixmap)
+{
+    const auto location = atlas.locate(pixmap);
+    assert(location);
+    writer.write<std::int32_t>(location->first);
+    writer.write(location->second);
+}
+
+// Placements are checked against the pages read from the same file, they are only turned into packed pixmaps once
+// the whole file has been validated and the pages are restored.
+struct StoredPlacement
+{
+    int page;
+    RectI rect;
+};
+
+bool readPlacement(Reader &reader, const std::vector<Pixmap> &pages, StoredPlacement &placement)
+{
+    std::int32_t page;
+    if (!reader.read(page) || !reader.read(placement.rect))
+        return false;
+    if (page < 0 || page >= static_cast<int>(pages.size()))
+        return false;
+    const auto &rect = placement.rect;
+    const auto bounds = RectI{{0, 0}, {pages[page].width, pages[page].height}};
+    if (rect.width() < 0 || rect.height() < 0 || !(rect.intersected(bounds) == rect))
+        return false;
+    placement.page = page;
+    return true;
+}
+
+void writeAtlas(Writer &writer, const TextureAtlas &atlas)
+{
+    writer.write<std::int32_t>(atlas.pageWidth());
+    writer.write<std::int32_t>(atlas.pageHeight());
+    writer.write(static_cast<std::uint8_t>(atlas.pixelType()));
+    writer.write<std::uint32_t>(atlas.pageCount());
+    for (int i = 0; i < atlas.pageCount(); ++i)
+    {
+        // pages grow, so they don't all have the same size
+        const auto *pixmap = atlas.page(i).pixmap();
+        writer.write<std::int32_t>(pixmap->width);
+        writer.write<std::int32_t>(pixmap->height);
+        writer.write(std::span<const unsigned char>(pixmap->pixels));
+    }
+}
+
+std::optional<std::vector<Pixmap>> readPages(Reader &reader, const TextureAtlas &atlas)
+{
+    std::int32_t pageWidth, pageHeight;
+    std::uint8_t pixelType;
+    std::uint32_t pageCount;
+    if (!reader.read(pageWidth) || !reader.read(pageHeight) || !reader.read(pixelType) || !reader.read(pageCount))
+        return std::nullopt;
+    if (pageWidth != atlas.pageWidth() || pageHeight != atlas.pageHeight() ||
+        static_cast<PixelType>(pixelType) != atlas.pixelType())
+        return std::nullopt;
+
+    std::vector<Pixmap> pages;
+    for (std::uint32_t i = 0; i < pageCount; ++i)
+    {
+        std::int32_t width, height;
+        if (!reader.read(width) || !reader.read(height) || width <= 0 || height <= 0 || width > pageWidth ||
+            height > pageHeight)
+            return std::nullopt;
+        auto &page = pages.emplace_back(width, height, atlas.pixelType());
+        if (!reader.read(std::span<unsigned char>(page.pixels)))
+            return std::nullopt;
+    }
+    return pages;
+}
+
+// Returns the index of the first restored page.
+int restorePages(TextureAtlas &atlas, std::vector<Pixmap> pages)
+{
+    const auto firstPage = atlas.pageCount();
+    for (auto &page : pages)
+        atlas.restorePage(std::move(page));
+    return firstPage;
+}
+
+PackedPixmap restorePlacement(const TextureAtlas &atlas, int firstPage, const StoredPlacement &placement)
+{
+    return atlas.packedPixmap(firstPage + placement.page, placement.rect);
+}
+} // namespace
+
+bool save(const std::string &path, const TextureAtlas &fontAtlas, const miniui::FontCache &fontCache,
+          const TextureAtlas &pixmapAtlas, const miniui::PixmapCache &pixmapCache)
+{
+    TRACE_ZONE("AtlasCache::save");
+
+    // written under another name first so that a crash halfway through doesn't leave a truncated cache behind
+    const auto tempPath = path + ".tmp";
+    std::FILE *file = std::fopen(tempPath.c_str(), "wb");
+    if (!file)
+    {
+        log("Failed to open atlas cache %s\n", tempPath.c_str());
+        return false;
+    }
+
+    Writer writer(file);
+    writer.write(Magic);
+    writer.write(Version);
+
+    writeAtlas(writer, fontAtlas);
+    const auto glyphTables = fontCache.glyphTables();
+    writer.write<std::uint32_t>(glyphTables.size());
+    for (const auto &table : glyphTables)
+    {
+        writer.write(table.name);
+        writer.write<std::int32_t>(table.pixelHeight);
+        writer.write<std::uint8_t>(table.sdf);
+        writer.write(table.contentHash);
+        writer.write<std::uint32_t>(table.glyphs.size());
+        for (const auto &[codepoint, glyph] : table.glyphs)
+        {
+            writer.write<std::int32_t>(codepoint);
+            writer.write(glyph.boundingBox);
+            writer.write(glyph.advanceWidth);
+            writer.write<std::uint8_t>(glyph.face);
+            writer.write<std::int32_t>(glyph.index);
+            writePlacement(writer, fontAtlas, glyph.pixmap);
+        }
+    }
+
+    writeAtlas(writer, pixmapAtlas);
+    const auto placements = pixmapCache.placements();
+    writer.write<std::uint32_t>(placements.size());
+    for (const auto &placement : placements)
+    {
+        writer.write(placement.source);
+        writer.write(placement.contentHash);
+        writePlacement(writer, pixmapAtlas, placement.pixmap);
+    }
+
+    const bool ok = writer.ok();
+    std::fclose(file);
+    if (!ok || std::rename(tempPath.c_str(), path.c_str()) != 0)
+    {
+        log("Failed to write atlas cache %s\n", path.c_str());
+        std::remove(tempPath.c_str());
+        return false;
+    }
+
+    log("Wrote atlas cache %s (%d font pages, %d pixmap pages)\n", path.c_str(), fontAtlas.pageCount(),
+        pixmapAtlas.pageCount());
+    return true;
+}
+
+bool load(const std::string &path, TextureAtlas &fontAtlas, miniui::FontCache &fontCache, TextureAtlas &pixmapAtlas,
+          miniui::PixmapCache &pixmapCache)
+{
+    TRACE_ZONE("AtlasCache::load");
+
+    auto file = Util::MappedFile::open(path);
+    if (!file)
+        return false;
+
+    Reader reader(file->data());
+    std::uint32_t magic, version;
+    if (!reader.read(magic) || !reader.read(version) || magic != Magic || version != Version)
+    {
+        log("Ignoring atlas cache %s: wrong format\n", path.c_str());
+        return false;
+    }
+
+    const auto corrupt = [&path] {
+        log("Ignoring atlas cache %s: truncated or corrupt\n", path.c_str());
+        return false;
+    };
+
+    // the whole file is read and validated before anything is restored, so that a truncated or corrupt cache leaves
+    // the atlases and the caches alone
+    auto fontPages = readPages(reader, fontAtlas);
+    if (!fontPages)
+        return corrupt();
+    std::uint32_t tableCount;
+    if (!reader.read(tableCount))
+        return corrupt();
+    // counts aren't trusted for preallocating, a corrupt one runs out of data soon enough
+    std::vector<miniui::FontCache::GlyphTable> glyphTables;
+    std::vector<StoredPlacement> glyphPlacements;
+    for (std::uint32_t i = 0; i < tableCount; ++i)
+    {
+        auto &table = glyphTables.emplace_back();
+        std::int32_t pixelHeight;
+        std::uint8_t sdf;
+        std::uint32_t glyphCount;
+        if (!reader.read(table.name) || !reader.read(pixelHeight) || !reader.read(sdf) ||
+            !reader.read(table.contentHash) || !reader.read(glyphCount))
+            return corrupt();
+        table.pixelHeight = pixelHeight;
+        table.sdf = sdf != 0;
+        for (std::uint32_t j = 0; j < glyphCount; ++j)
+        {
+            std::int32_t codepoint, index;
+            std::uint8_t face;
+            miniui::Font::Glyph glyph;
+            if (!reader.read(codepoint) || !reader.read(glyph.boundingBox) || !reader.read(glyph.advanceWidth) ||
+                !reader.read(face) || !reader.read(index) ||
+                !readPlacement(reader, *fontPages, glyphPlacements.emplace_back()))
+                return corrupt();
+            glyph.face = face;
+            glyph.index = index;
+            table.glyphs.emplace_back(codepoint, glyph);
+        }
+    }
+
+    auto pixmapPages = readPages(reader, pixmapAtlas);
+    if (!pixmapPages)
+        return corrupt();
+    std::uint32_t placementCount;
+    if (!reader.read(placementCount))
+        return corrupt();
+    std::vector<miniui::PixmapCache::Placement> placements;
+    std::vector<StoredPlacement> pixmapPlacements;
+    for (std::uint32_t i = 0; i < placementCount; ++i)
+    {
+        auto &placement = placements.emplace_back();
+        if (!reader.read(placement.source) || !reader.read(placement.contentHash) ||
+            !readPlacement(reader, *pixmapPages, pixmapPlacements.emplace_back()))
+            return corrupt();
+    }
+
+    // restored pages are only queued at low priority, the parts a frame samples are uploaded on demand
+    const auto firstFontPage = restorePages(fontAtlas, std::move(*fontPages));
+    auto glyphPlacement = glyphPlacements.begin();
+    for (auto &table : glyphTables)
+    {
+        for (auto &glyph : table.glyphs)
+            glyph.second.pixmap = restorePlacement(fontAtlas, firstFontPage, *glyphPlacement++);
+    }
+    fontCache.setWarmGlyphTables(std::move(glyphTables));
+
+    const auto firstPixmapPage = restorePages(pixmapAtlas, std::move(*pixmapPages));
+    for (std::size_t i = 0; i < placements.size(); ++i)
+        placements[i].pixmap = restorePlacement(pixmapAtlas, firstPixmapPage, pixmapPlacements[i]);
+    pixmapCache.setWarmPlacements(std::move(placements));
+
+    log("Loaded atlas cache %s (%d font pages, %d pixmap pages)\n", path.c_str(), fontAtlas.pageCount(),
+        pixmapAtlas.pageCount());
+    return true;
+}
+
+} // namespace AtlasCache
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <string>
+
+class TextureAtlas;
+
+namespace miniui
+{
+class FontCache;
+class PixmapCache;
+} // namespace miniui
+
+// Persists the font and pixmap atlases between runs: the page images, the glyph table of every font and the pixmap
+// placements, the latter two keyed by the content hash of the asset they came from. Loading must happen before
+// anything is added to the atlases. Restored pages are read-only, new glyphs and images go to new pages.
+namespace AtlasCache
+{
+bool save(const std::string &path, const TextureAtlas &fontAtlas, const miniui::FontCache &fontCache,
+          const TextureAtlas &pixmapAtlas, const miniui::PixmapCache &pixmapCache);
+bool load(const std::string &path, TextureAtlas &fontAtlas, miniui::FontCache &fontCache, TextureAtlas &pixmapAtlas,
+          miniui::PixmapCache &pixmapCache);
+} // namespace AtlasCache
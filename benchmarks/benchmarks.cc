@@ -0,0 +1,560 @@
+#include "headlesscontext.h"
+#include "system.h"
+#include "fontcache.h"
+#include "font.h"
+#include "ioutil.h"
+#include "miniui.h"
+#include "outlinerasterizer.h"
+#include "painter.h"
+#include "pixmap.h"
+#include "spritebatcher.h"
+#include "texture.h"
+#include "textureatlas.h"
+#include "textureatlaspage.h"
+#include "textrun.h"
+#include "log.h"
+
+#include <GL/glew.h>
+
+#include <stb_truetype.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <optional>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Microbenchmarks for the rendering and layout hot paths. Run from the repository root so that assets/ resolves:
+//
+//   benchmarks [--filter=<substring>] [--runs=<count>] [--json=<path>]
+
+namespace
+{
+
+constexpr auto FontName = "OpenSans_Regular";
+constexpr auto FontPath = "assets/fonts/OpenSans_Regular.ttf";
+constexpr auto RandomSeed = 1234u;
+
+struct Result
+{
+    std::string name;
+    std::size_t opsPerRun;
+    double medianNs; // per op
+    double minNs;    // per op
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+class Runner
+{
+public:
+    std::string filter;
+    int runs = 15;
+
+    bool enabled(const std::string &name) const { return filter.empty() || name.find(filter) != std::string::npos; }
+
+    // Calls setup() (untimed) then body() (timed) `runs` times, after one warmup run.
+    template<typename Setup, typename Body>
+    Result &run(const std::string &name, std::size_t opsPerRun, Setup &&setup, Body &&body)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        std::vector<double> times;
+        for (int i = 0; i < runs + 1; ++i)
+        {
+            setup();
+            const auto start = Clock::now();
+            body();
+            glFinish();
+            const auto end = Clock::now();
+            if (i > 0)
+                times.push_back(std::chrono::duration<double, std::nano>(end - start).count() / opsPerRun);
+        }
+        std::sort(times.begin(), times.end());
+
+        m_results.push_back({name, opsPerRun, times[times.size() / 2], times.front(), {}});
+        auto &result = m_results.back();
+        log("%-56s %10.1f ns/op (min %10.1f)\n", name.c_str(), result.medianNs, result.minNs);
+        return result;
+    }
+
+    template<typename Body>
+    Result &run(const std::string &name, std::size_t opsPerRun, Body &&body)
+    {
+        return run(name, opsPerRun, [] {}, std::forward<Body>(body));
+    }
+
+    bool writeJson(const std::string &path) const
+    {
+        std::FILE *file = std::fopen(path.c_str(), "w");
+        if (!file)
+        {
+            log("Failed to open %s\n", path.c_str());
+            return false;
+        }
+        std::fprintf(file, "{\n  \"runs\": %d,\n  \"benchmarks\": [\n", runs);
+        for (std::size_t i = 0; i < m_results.size(); ++i)
+        {
+            const auto &result = m_results[i];
+            std::fprintf(file, "    {\"name\": \"%s\", \"opsPerRun\": %zu, \"medianNs\": %.3f, \"minNs\": %.3f",
+                         result.name.c_str(), result.opsPerRun, result.medianNs, result.minNs);
+            for (const auto &[key, value] : result.counters)
+                std::fprintf(file, ", \"%s\": %.6g", key.c_str(), value);
+            std::fprintf(file, "}%s\n", i + 1 < m_results.size() ? "," : "");
+        }
+        std::fprintf(file, "  ]\n}\n");
+        std::fclose(file);
+        return true;
+    }
+
+private:
+    std::vector<Result> m_results;
+};
+
+std::u32string toU32(std::string_view text)
+{
+    return std::u32string(text.begin(), text.end());
+}
+
+const std::u32string &paragraph()
+{
+    static const auto text = [] {
+        const std::string_view sentence = "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor "
+                                          "incididunt ut labore et dolore magna aliqua. Ut enim ad minim veniam, quis "
+                                          "nostrud exercitation ullamco laboris nisi ut aliquip ex ea commodo consequat. ";
+        std::u32string text;
+        for (int i = 0; i < 20; ++i)
+            text += toU32(sentence);
+        text.pop_back();
+        return text;
+    }();
+    return text;
+}
+
+// Bounding boxes of the Latin glyphs of the demo font at a range of pixel sizes.
+std::vector<glm::ivec2> glyphSizeCorpus()
+{
+    std::vector<glm::ivec2> sizes;
+
+    auto ttf = Util::readFile(FontPath);
+    if (!ttf)
+    {
+        log("Failed to read %s\n", FontPath);
+        return sizes;
+    }
+    stbtt_fontinfo font;
+    if (!stbtt_InitFont(&font, ttf->data(), stbtt_GetFontOffsetForIndex(ttf->data(), 0)))
+        return sizes;
+
+    constexpr auto Border = 1;
+    for (const int pixelHeight : {14, 20, 32, 40, 64})
+    {
+        const auto scale = stbtt_ScaleForPixelHeight(&font, pixelHeight);
+        for (int codepoint = 0x20; codepoint < 0x250; ++codepoint)
+        {
+            if (!stbtt_FindGlyphIndex(&font, codepoint))
+                continue;
+            int x0, y0, x1, y1;
+            stbtt_GetCodepointBitmapBox(&font, codepoint, scale, scale, &x0, &y0, &x1, &y1);
+            sizes.emplace_back(x1 - x0 + 2 * Border, y1 - y0 + 2 * Border);
+        }
+    }
+
+    // arrival order in a real app is roughly random
+    std::shuffle(sizes.begin(), sizes.end(), std::mt19937(RandomSeed));
+
+    return sizes;
+}
+
+void benchmarkSpriteBatcher(Runner &runner)
+{
+    constexpr auto TextureSize = 16;
+    std::vector<std::unique_ptr<gl::Texture>> textures;
+    for (int i = 0; i < 16; ++i)
+        textures.push_back(std::make_unique<gl::Texture>(TextureSize, TextureSize, PixelType::RGBA));
+
+    auto batcher = std::make_unique<gl::SpriteBatcher>();
+    batcher->setTransformMatrix(glm::mat4(1));
+    batcher->setBatchProgram(ShaderManager::Decal);
+
+    for (const int quadCount : {1000, 10000, 50000})
+    {
+        for (const int textureCount : {1, 4, 16})
+        {
+            const auto name = "SpriteBatcher/addSprite+flush/quads:" + std::to_string(quadCount) +
+                              "/textures:" + std::to_string(textureCount);
+            if (!runner.enabled(name))
+                continue;
+
+            std::mt19937 rng(RandomSeed);
+            std::uniform_real_distribution<float> coord(-1.0f, 1.0f);
+            std::uniform_int_distribution<int> texture(0, textureCount - 1);
+            struct Sprite
+            {
+                const AbstractTexture *texture;
+                RectF rect;
+            };
+            std::vector<Sprite> sprites(quadCount);
+            for (auto &sprite : sprites)
+            {
+                const auto p = glm::vec2(coord(rng), coord(rng));
+                sprite = {textures[texture(rng)].get(), RectF{p, p + glm::vec2(0.01f, 0.01f)}};
+            }
+
+            // texture coordinates are in pixels, the whole texture
+            const auto texRect = RectF{{0, 0}, {TextureSize, TextureSize}};
+            runner.run(name, quadCount, [&] {
+                batcher->begin();
+                for (const auto &sprite : sprites)
+                    batcher->addSprite(sprite.texture, sprite.rect, texRect, glm::vec4(1), 0);
+                batcher->flush();
+            });
+        }
+    }
+}
+
+// Near-square boxes the size of CJK ideographs at 14-40 px, one size per glyph.
+std::vector<glm::ivec2> cjkGlyphSizeCorpus()
+{
+    constexpr auto GlyphCount = 6000;
+
+    std::mt19937 rng(RandomSeed);
+    std::uniform_int_distribution<int> pixelHeight(14, 40);
+    std::uniform_real_distribution<float> extent(0.8f, 1.0f);
+
+    std::vector<glm::ivec2> sizes;
+    sizes.reserve(GlyphCount);
+    for (int i = 0; i < GlyphCount; ++i)
+    {
+        const auto height = pixelHeight(rng);
+        sizes.emplace_back(static_cast<int>(height * extent(rng)) + 2, static_cast<int>(height * extent(rng)) + 2);
+    }
+    return sizes;
+}
+
+void benchmarkAtlasInsert(Runner &runner)
+{
+    constexpr auto PageSize = 1024;
+
+    const std::pair<const char *, TextureAtlasPage::Packer> packers[] = {
+        {"guillotine", TextureAtlasPage::Packer::Guillotine},
+        {"skyline", TextureAtlasPage::Packer::Skyline},
+        {"maxrects", TextureAtlasPage::Packer::MaxRects},
+    };
+    const std::pair<const char *, std::vector<glm::ivec2> (*)()> corpora[] = {
+        {"latin-glyphs", glyphSizeCorpus},
+        {"cjk-glyphs", cjkGlyphSizeCorpus},
+    };
+
+    for (const auto &[corpusName, corpus] : corpora)
+    {
+        std::vector<Pixmap> pixmaps;
+        for (const auto &[packerName, packer] : packers)
+        {
+            const auto name = std::string("TextureAtlasPage/insert/") + corpusName + "/" + packerName;
+            if (!runner.enabled(name))
+                continue;
+
+            if (pixmaps.empty())
+            {
+                for (const auto &size : corpus())
+                    pixmaps.emplace_back(size.x, size.y, PixelType::Grayscale);
+                if (pixmaps.empty())
+                    return;
+            }
+
+            // first fit over as many pages as needed, like TextureAtlas::addPixmap
+            std::vector<std::unique_ptr<TextureAtlasPage>> pages;
+            auto &result = runner.run(
+                name, pixmaps.size(), [&] { pages.clear(); },
+                [&] {
+                    for (const auto &pixmap : pixmaps)
+                    {
+                        bool inserted = false;
+                        for (auto &page : pages)
+                        {
+                            if ((inserted = page->insert(pixmap).has_value()))
+                                break;
+                        }
+                        if (!inserted)
+                        {
+                            pages.push_back(
+                                std::make_unique<TextureAtlasPage>(PageSize, PageSize, PixelType::Grayscale, packer));
+                            pages.back()->insert(pixmap);
+                        }
+                    }
+                });
+            std::size_t usedArea = 0;
+            for (const auto &page : pages)
+                usedArea += page->usedArea();
+            result.counters.emplace_back("pages", pages.size());
+            result.counters.emplace_back("occupancy",
+                                         static_cast<double>(usedArea) / (pages.size() * PageSize * PageSize));
+        }
+    }
+}
+
+void benchmarkFont(Runner &runner)
+{
+    auto *font = System::instance()->fontCache()->font(FontName, 32);
+    if (!font)
+        return;
+
+    const auto &text = paragraph();
+
+    if (const auto name = std::string("Font/glyph/hit"); runner.enabled(name))
+    {
+        font->textWidth(text); // populate
+        runner.run(name, text.size(), [&] {
+            float sum = 0.0f;
+            for (auto ch : text)
+                sum += font->glyph(ch)->advanceWidth;
+            volatile auto sink = sum;
+            (void)sink;
+        });
+    }
+
+    if (const auto name = std::string("Font/glyph/miss"); runner.enabled(name))
+    {
+        constexpr auto FirstCodepoint = 0x20;
+        constexpr auto LastCodepoint = 0x250;
+        const auto face = miniui::FontFace::load(FontPath);
+        if (!face)
+            return;
+        std::unique_ptr<TextureAtlas> atlas;
+        std::unique_ptr<miniui::Font> missFont;
+        runner.run(
+            name, LastCodepoint - FirstCodepoint,
+            [&] {
+                missFont.reset();
+                atlas = std::make_unique<TextureAtlas>(1024, 1024, PixelType::Grayscale);
+                missFont = std::make_unique<miniui::Font>(atlas.get(), face.get(), 32);
+            },
+            [&] {
+                for (int codepoint = FirstCodepoint; codepoint < LastCodepoint; ++codepoint)
+                    missFont->glyph(codepoint);
+            });
+    }
+
+    if (const auto name = std::string("Font/textWidth/paragraph"); runner.enabled(name))
+    {
+        runner.run(name, text.size(), [&] {
+            volatile auto sink = font->textWidth(text);
+            (void)sink;
+        });
+    }
+}
+
+void benchmarkRasterizer(Runner &runner)
+{
+    auto ttf = Util::readFile(FontPath);
+    if (!ttf)
+    {
+        log("Failed to read %s\n", FontPath);
+        return;
+    }
+    stbtt_fontinfo font;
+    if (!stbtt_InitFont(&font, ttf->data(), stbtt_GetFontOffsetForIndex(ttf->data(), 0)))
+        return;
+
+    struct GlyphBox
+    {
+        int codepoint;
+        int width;
+        int height;
+    };
+
+    OutlineRasterizer rasterizer;
+    std::vector<unsigned char> pixels;
+    for (const int pixelHeight : {14, 20, 40, 64})
+    {
+        const auto scale = stbtt_ScaleForPixelHeight(&font, pixelHeight);
+        std::vector<GlyphBox> glyphs;
+        for (int codepoint = 0x20; codepoint < 0x250; ++codepoint)
+        {
+            if (!stbtt_FindGlyphIndex(&font, codepoint))
+                continue;
+            int x0, y0, x1, y1;
+            stbtt_GetCodepointBitmapBox(&font, codepoint, scale, scale, &x0, &y0, &x1, &y1);
+            if (x1 > x0 && y1 > y0)
+                glyphs.push_back({codepoint, x1 - x0, y1 - y0});
+        }
+        for (const auto &glyph : glyphs)
+            pixels.resize(std::max<std::size_t>(pixels.size(), glyph.width * glyph.height));
+
+        const auto suffix = "/latin/px:" + std::to_string(pixelHeight);
+        if (const auto name = "Rasterizer/stb" + suffix; runner.enabled(name))
+        {
+            runner.run(name, glyphs.size(), [&] {
+                for (const auto &glyph : glyphs)
+                    stbtt_MakeCodepointBitmap(&font, pixels.data(), glyph.width, glyph.height, glyph.width, scale,
+                                              scale, glyph.codepoint);
+            });
+        }
+        if (const auto name = "Rasterizer/accumulation" + suffix; runner.enabled(name))
+        {
+            runner.run(name, glyphs.size(), [&] {
+                for (const auto &glyph : glyphs)
+                    rasterizer.rasterizeCodepoint(&font, glyph.codepoint, scale, 0.0f, pixels.data(), glyph.width,
+                                                  glyph.height, glyph.width);
+            });
+        }
+    }
+}
+
+void benchmarkDrawText(Runner &runner)
+{
+    auto *font = System::instance()->fontCache()->font(FontName, 20);
+    if (!font)
+        return;
+
+    const auto &text = paragraph();
+    auto *painter = System::instance()->uiPainter();
+    painter->setWindowSize(1024, 1024);
+
+    // begin() resets the font
+    if (const auto name = std::string("Painter/drawText/paragraph"); runner.enabled(name))
+    {
+        runner.run(name, text.size(), [&] {
+            painter->begin();
+            painter->setFont(font);
+            painter->drawText(text, {0, 0}, glm::vec4(1), 0);
+            painter->end();
+        });
+    }
+
+    if (const auto name = std::string("Painter/drawTextRun/paragraph"); runner.enabled(name))
+    {
+        miniui::TextRun run(font, text);
+        runner.run(name, text.size(), [&] {
+            painter->begin();
+            painter->setFont(font);
+            painter->drawTextRun(run, {0, 0}, glm::vec4(1), 0);
+            painter->end();
+        });
+    }
+}
+
+void benchmarkMultiLineText(Runner &runner)
+{
+    const auto name = std::string("MultiLineText/breakTextLines/paragraph");
+    if (!runner.enabled(name))
+        return;
+
+    auto *font = System::instance()->fontCache()->font(FontName, 20);
+    if (!font)
+        return;
+
+    // setText() relayouts only when the text changes, so alternate between two paragraphs
+    const auto &text = paragraph();
+    const auto otherText = text.substr(1);
+
+    miniui::MultiLineText item(font);
+    item.setFixedWidth(400);
+    bool flip = false;
+    runner.run(name, text.size(), [&] {
+        item.setText(flip ? otherText : text);
+        flip = !flip;
+    });
+}
+
+void benchmarkLayout(Runner &runner)
+{
+    using namespace miniui;
+
+    constexpr auto RowCount = 200;
+    constexpr auto ItemsPerRow = 20;
+    constexpr auto ItemCount = RowCount * ItemsPerRow;
+
+    std::unique_ptr<Column> column;
+    Rectangle *leaf = nullptr;
+    const auto buildTree = [&] {
+        column = std::make_unique<Column>();
+        for (int i = 0; i < RowCount; ++i)
+        {
+            auto row = std::make_unique<Row>();
+            row->setSpacing(2);
+            for (int j = 0; j < ItemsPerRow; ++j)
+            {
+                auto rect = std::make_unique<Rectangle>(10 + j, 10 + i % 7);
+                leaf = rect.get();
+                row->addItem(std::move(rect));
+            }
+            column->addItem(std::move(row));
+        }
+    };
+
+    if (const auto name = std::string("Layout/build/rows:200/items:20"); runner.enabled(name))
+        runner.run(name, ItemCount, buildTree);
+
+    buildTree();
+
+    if (const auto name = std::string("Layout/Column::updateLayout/rows:200"); runner.enabled(name))
+    {
+        float spacing = 0.0f;
+        runner.run(name, RowCount, [&] {
+            spacing = spacing == 0.0f ? 1.0f : 0.0f;
+            column->setSpacing(spacing);
+        });
+    }
+
+    if (const auto name = std::string("Layout/leafResize/rows:200/items:20"); runner.enabled(name))
+    {
+        float width = 10.0f;
+        runner.run(name, 1, [&] {
+            width = width == 10.0f ? 30.0f : 10.0f;
+            leaf->setWidth(width);
+        });
+    }
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Runner runner;
+    std::string jsonPath;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const auto value = [&arg](std::string_view option) -> std::optional<std::string> {
+            if (arg.substr(0, option.size()) != option)
+                return std::nullopt;
+            return std::string(arg.substr(option.size()));
+        };
+        if (auto v = value("--filter="))
+            runner.filter = *v;
+        else if (auto v = value("--runs="))
+            runner.runs = std::max(1, std::atoi(v->c_str()));
+        else if (auto v = value("--json="))
+            jsonPath = *v;
+        else
+        {
+            log("Usage: %s [--filter=<substring>] [--runs=<count>] [--json=<path>]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    HeadlessContext context;
+    if (!context.isValid())
+        return 1;
+
+    System::initialize();
+
+    benchmarkSpriteBatcher(runner);
+    benchmarkAtlasInsert(runner);
+    benchmarkFont(runner);
+    benchmarkRasterizer(runner);
+    benchmarkDrawText(runner);
+    benchmarkMultiLineText(runner);
+    benchmarkLayout(runner);
+
+    System::shutdown();
+
+    if (!jsonPath.empty() && !runner.writeJson(jsonPath))
+        return 1;
+}
@@ -0,0 +1,370 @@
+#include "framebuffer.h"
+#include "headlesscontext.h"
+#include "ioutil.h"
+#include "painter.h"
+#include "paintercapture.h"
+#include "pixmap.h"
+#include "pixeltype.h"
+#include "system.h"
+#include "texture.h"
+#include "textureatlas.h"
+#include "log.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Replays a painter capture (see PainterCapture, recorded by running the game with CAPTURE_FILE=<path>) as fast as
+// possible and prints frame-time statistics.
+//
+//   replay <capture> [--loops=N]
+
+namespace
+{
+
+using Command = miniui::PainterCapture::Command;
+
+struct Op
+{
+    Command command;
+    std::uint32_t texture = 0;
+    RectF rect;
+    RectF texCoord;
+    RectI subRect;
+    glm::vec4 color;
+    glm::vec2 center;
+    float radius = 0.0f;
+    int depth = 0;
+    int channel = 0;
+    int width = 0;
+    int height = 0;
+    PixelType pixelType = PixelType::Invalid;
+    const unsigned char *pixels = nullptr;
+};
+
+class Reader
+{
+public:
+    explicit Reader(const std::vector<unsigned char> &data)
+        : m_data(data)
+    {
+    }
+
+    bool atEnd() const { return m_offset == m_data.size(); }
+
+    template<typename T>
+    bool read(T &value)
+    {
+        if (m_offset + sizeof(T) > m_data.size())
+            return false;
+        std::memcpy(&value, m_data.data() + m_offset, sizeof(T));
+        m_offset += sizeof(T);
+        return true;
+    }
+
+    const unsigned char *skip(std::size_t size)
+    {
+        if (m_offset + size > m_data.size())
+            return nullptr;
+        const auto *p = m_data.data() + m_offset;
+        m_offset += size;
+        return p;
+    }
+
+private:
+    const std::vector<unsigned char> &m_data;
+    std::size_t m_offset = 0;
+};
+
+std::optional<std::vector<Op>> parse(const std::vector<unsigned char> &data)
+{
+    Reader reader(data);
+
+    std::uint32_t magic, version;
+    if (!reader.read(magic) || !reader.read(version) || magic != miniui::PainterCapture::Magic ||
+        version != miniui::PainterCapture::Version)
+    {
+        log("Not a painter capture (or wrong version)\n");
+        return std::nullopt;
+    }
+
+    std::vector<Op> ops;
+    while (!reader.atEnd())
+    {
+        Op op;
+        std::int32_t i0 = 0, i1 = 0;
+        bool ok = reader.read(op.command);
+        switch (op.command)
+        {
+        case Command::FrameBegin:
+            ok = ok && reader.read(i0) && reader.read(i1);
+            op.width = i0;
+            op.height = i1;
+            break;
+        case Command::FrameEnd:
+            break;
+        case Command::ClipRect:
+            ok = ok && reader.read(op.rect);
+            break;
+        case Command::Rect:
+        case Command::Capsule:
+            ok = ok && reader.read(op.rect) && reader.read(op.color) && reader.read(i0);
+            op.depth = i0;
+            break;
+        case Command::Pixmap:
+        case Command::Glyph:
+        case Command::SdfGlyph: {
+            std::uint8_t channel = 0;
+            ok = ok && reader.read(op.texture) && reader.read(channel) && channel < 4 && reader.read(op.rect) &&
+                 reader.read(op.texCoord) && reader.read(op.color) && reader.read(i0);
+            op.channel = channel;
+            op.depth = i0;
+            break;
+        }
+        case Command::Circle:
+            ok = ok && reader.read(op.center) && reader.read(op.radius) && reader.read(op.color) && reader.read(i0);
+            op.depth = i0;
+            break;
+        case Command::RoundedRect:
+            ok = ok && reader.read(op.rect) && reader.read(op.radius) && reader.read(op.color) && reader.read(i0);
+            op.depth = i0;
+            break;
+        case Command::TextureData:
+        case Command::TextureSubData: {
+            std::uint8_t pixelType = 0;
+            ok = ok && reader.read(op.texture) && reader.read(i0) && reader.read(i1) && reader.read(pixelType);
+            op.width = i0;
+            op.height = i1;
+            op.pixelType = static_cast<PixelType>(pixelType);
+            op.subRect = RectI{{0, 0}, {op.width, op.height}};
+            if (op.command == Command::TextureSubData)
+            {
+                const auto bounds = RectI{{0, 0}, {op.width, op.height}};
+                ok = ok && reader.read(op.subRect) && op.subRect.width() > 0 && op.subRect.height() > 0 &&
+                     op.subRect.intersected(bounds) == op.subRect;
+            }
+            if (ok)
+            {
+                op.pixels = reader.skip(op.subRect.width() * op.subRect.height() * pixelSizeInBytes(op.pixelType));
+                ok = op.pixels != nullptr;
+            }
+            break;
+        }
+        default:
+            ok = false;
+            break;
+        }
+        if (!ok)
+        {
+            log("Truncated or corrupt capture after %zu commands\n", ops.size());
+            return std::nullopt;
+        }
+        ops.push_back(op);
+    }
+    return ops;
+}
+
+class Player
+{
+public:
+    void play(const std::vector<Op> &ops, std::vector<double> &frameTimes)
+    {
+        using Clock = std::chrono::steady_clock;
+
+        auto *painter = System::instance()->uiPainter();
+        Clock::time_point frameStart;
+
+        for (const auto &op : ops)
+        {
+            switch (op.command)
+            {
+            case Command::FrameBegin:
+                frameStart = Clock::now();
+                beginFrame(op.width, op.height);
+                painter->setWindowSize(op.width, op.height);
+                painter->begin();
+                break;
+            case Command::FrameEnd:
+                painter->end();
+                glDisable(GL_SCISSOR_TEST);
+                glFinish();
+                frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - frameStart).count());
+                break;
+            case Command::ClipRect:
+                painter->setClipRect(op.rect);
+                break;
+            case Command::Rect:
+                painter->drawRect(op.rect, op.color, op.depth);
+                break;
+            case Command::Pixmap:
+                painter->drawPixmap(packedPixmap(op), op.rect, op.color, op.depth);
+                break;
+            case Command::Glyph:
+                painter->drawGlyph(packedPixmap(op), op.rect, op.color, op.depth);
+                break;
+            case Command::SdfGlyph:
+                painter->drawSdfGlyph(packedPixmap(op), op.rect, op.color, op.depth);
+                break;
+            case Command::Circle:
+                painter->drawCircle(op.center, op.radius, op.color, op.depth);
+                break;
+            case Command::Capsule:
+                painter->drawCapsule(op.rect, op.color, op.depth);
+                break;
+            case Command::RoundedRect:
+                painter->drawRoundedRect(op.rect, op.radius, op.color, op.depth);
+                break;
+            case Command::TextureData:
+            case Command::TextureSubData:
+                uploadTexture(op);
+                break;
+            }
+        }
+    }
+
+private:
+    void beginFrame(int width, int height)
+    {
+        if (!m_framebuffer || m_framebuffer->width() != width || m_framebuffer->height() != height)
+        {
+            m_framebuffer = std::make_unique<gl::Framebuffer>(width, height);
+            m_framebuffer->bind();
+        }
+        glViewport(0, 0, width, height);
+        glClearColor(0, 0.5, 1, 1);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glEnable(GL_BLEND);
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+        glEnable(GL_SCISSOR_TEST);
+    }
+
+    PackedPixmap packedPixmap(const Op &op) const
+    {
+        auto it = m_textures.find(op.texture);
+        const AbstractTexture *texture = it != m_textures.end() ? it->second.texture.get() : nullptr;
+        return PackedPixmap{0, 0, op.texCoord, texture, op.channel};
+    }
+
+    void uploadTexture(const Op &op)
+    {
+        auto &texture = m_textures[op.texture];
+        const auto pixelSize = pixelSizeInBytes(op.pixelType);
+        if (!texture.texture)
+        {
+            texture.texture = std::make_unique<gl::Texture>(op.width, op.height, op.pixelType);
+            texture.contents = Pixmap(op.width, op.height, op.pixelType);
+        }
+        else if (texture.contents.width != op.width || texture.contents.height != op.height)
+        {
+            // An atlas page grew mid-frame. Sprites queued before still point at the texture, so it's resized in
+            // place, and it keeps what it held.
+            Pixmap contents(op.width, op.height, op.pixelType);
+            const auto rowSize = std::min(contents.width, texture.contents.width) * pixelSize;
+            for (int y = 0; y < std::min(contents.height, texture.contents.height); ++y)
+            {
+                std::memcpy(contents.pixels.data() + y * contents.width * pixelSize,
+                            texture.contents.pixels.data() + y * texture.contents.width * pixelSize, rowSize);
+            }
+            texture.contents = std::move(contents);
+            texture.texture->resize(op.width, op.height);
+            texture.texture->setData(texture.contents.pixels.data());
+        }
+
+        const auto rowSize = op.subRect.width() * pixelSize;
+        for (int y = 0; y < op.subRect.height(); ++y)
+        {
+            std::memcpy(texture.contents.pixels.data() +
+                            ((op.subRect.min.y + y) * op.width + op.subRect.min.x) * pixelSize,
+                        op.pixels + y * rowSize, rowSize);
+        }
+        texture.texture->setData(op.subRect, op.pixels, op.subRect.width());
+    }
+
+    struct Texture
+    {
+        std::unique_ptr<gl::Texture> texture;
+        Pixmap contents; // what was uploaded so far, to carry over when the texture grows
+    };
+
+    std::unique_ptr<gl::Framebuffer> m_framebuffer;
+    std::unordered_map<std::uint32_t, Texture> m_textures;
+};
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    std::string capturePath;
+    int loops = 1;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        if (arg.substr(0, 8) == "--loops=")
+            loops = std::max(1, std::atoi(argv[i] + 8));
+        else if (arg.substr(0, 2) != "--" && capturePath.empty())
+            capturePath = arg;
+        else
+        {
+            capturePath.clear();
+            break;
+        }
+    }
+    if (capturePath.empty())
+    {
+        log("Usage: %s <capture> [--loops=N]\n", argv[0]);
+        return 1;
+    }
+
+    const auto data = Util::readFile(capturePath);
+    if (!data)
+    {
+        log("Failed to read %s\n", capturePath.c_str());
+        return 1;
+    }
+    const auto ops = parse(*data);
+    if (!ops)
+        return 1;
+
+    HeadlessContext context;
+    if (!context.isValid())
+        return 1;
+
+    System::initialize();
+
+    {
+        Player player;
+        std::vector<double> frameTimes;
+        const auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < loops; ++i)
+            player.play(*ops, frameTimes);
+        const auto total = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        gl::Framebuffer::unbind();
+
+        if (frameTimes.empty())
+        {
+            log("No frames in capture\n");
+        }
+        else
+        {
+            std::sort(frameTimes.begin(), frameTimes.end());
+            const auto percentile = [&frameTimes](double p) {
+                return frameTimes[static_cast<std::size_t>(p * (frameTimes.size() - 1) + 0.5)];
+            };
+            log("%zu commands, %zu frames in %.2f ms (%.1f fps)\n", ops->size() * loops, frameTimes.size(), total,
+                1000.0 * frameTimes.size() / total);
+            log("Frame time (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", percentile(0.5), percentile(0.9),
+                percentile(0.99), frameTimes.back());
+        }
+    }
+
+    System::shutdown();
+}
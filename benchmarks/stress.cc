@@ -0,0 +1,165 @@
+#include "fontcache.h"
+#include "headlesscontext.h"
+#include "miniui.h"
+#include "painter.h"
+#include "stressscene.h"
+#include "system.h"
+#include "log.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Renders a synthetic miniui scene for a fixed number of frames and prints frame-time percentiles. Run from the
+// repository root so that assets/ resolves.
+
+namespace
+{
+void usage(const char *argv0)
+{
+    log("Usage: %s [--rows=N] [--labels=M] [--depth=D] [--clipped=F] [--images=F] [--animated=F] [--seed=S] "
+        "[--frames=N] [--width=W] [--height=H] [--font-pages=N] [--sdf] [--async-glyphs] "
+        "[--rasterizer=stb|accumulation] [--subpixel]\n",
+        argv0);
+}
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    StressSceneParams params;
+    int frameCount = 500;
+    int width = 1280;
+    int height = 720;
+    std::optional<int> fontPageBudget;
+    bool sdfGlyphs = false;
+    bool asyncGlyphs = false;
+    auto rasterizer = miniui::Font::Rasterizer::Stb;
+    bool subpixelGlyphs = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const auto value = [&arg](std::string_view option) -> std::optional<std::string> {
+            if (arg.substr(0, option.size()) != option)
+                return std::nullopt;
+            return std::string(arg.substr(option.size()));
+        };
+        if (auto v = value("--rows="))
+            params.rows = std::atoi(v->c_str());
+        else if (auto v = value("--labels="))
+            params.labelsPerRow = std::atoi(v->c_str());
+        else if (auto v = value("--depth="))
+            params.depth = std::max(1, std::atoi(v->c_str()));
+        else if (auto v = value("--clipped="))
+            params.clippedFraction = std::atof(v->c_str());
+        else if (auto v = value("--images="))
+            params.imageFraction = std::atof(v->c_str());
+        else if (auto v = value("--animated="))
+            params.animatedFraction = std::atof(v->c_str());
+        else if (auto v = value("--seed="))
+            params.seed = std::atoi(v->c_str());
+        else if (auto v = value("--frames="))
+            frameCount = std::max(1, std::atoi(v->c_str()));
+        else if (auto v = value("--width="))
+            width = std::atoi(v->c_str());
+        else if (auto v = value("--height="))
+            height = std::atoi(v->c_str());
+        else if (auto v = value("--font-pages="))
+            fontPageBudget = std::atoi(v->c_str());
+        else if (arg == "--sdf")
+            sdfGlyphs = true;
+        else if (arg == "--async-glyphs")
+            asyncGlyphs = true;
+        else if (arg == "--rasterizer=stb")
+            rasterizer = miniui::Font::Rasterizer::Stb;
+        else if (arg == "--rasterizer=accumulation")
+            rasterizer = miniui::Font::Rasterizer::Accumulation;
+        else if (arg == "--subpixel")
+            subpixelGlyphs = true;
+        else
+        {
+            usage(argv[0]);
+            return 1;
+        }
+    }
+
+    HeadlessContext context(width, height);
+    if (!context.isValid())
+        return 1;
+
+    System::initialize();
+    if (fontPageBudget)
+        System::instance()->fontCache()->setPageBudget(*fontPageBudget);
+    System::instance()->fontCache()->setSdfGlyphs(sdfGlyphs);
+    System::instance()->fontCache()->setAsyncGlyphs(asyncGlyphs);
+    System::instance()->fontCache()->setGlyphRasterizer(rasterizer);
+    System::instance()->fontCache()->setSubpixelGlyphs(subpixelGlyphs);
+
+    {
+        using Clock = std::chrono::steady_clock;
+
+        const auto buildStart = Clock::now();
+        StressScene scene(params);
+        const auto buildTime = std::chrono::duration<double, std::milli>(Clock::now() - buildStart).count();
+
+        log("Scene: %d rows x %d cells, depth %d, %d labels (%d animated), %d images, built in %.2f ms\n",
+            params.rows, params.labelsPerRow, params.depth, scene.labelCount(), scene.animatedLabelCount(),
+            scene.imageCount(), buildTime);
+
+        auto *painter = System::instance()->uiPainter();
+        painter->setWindowSize(width, height);
+
+        auto &stats = System::instance()->frameStats();
+        std::size_t bytesUploaded = 0;
+        double uploadTime = 0.0;
+        int uploadFrames = 0;
+
+        std::vector<double> frameTimes;
+        frameTimes.reserve(frameCount);
+        for (int frame = 0; frame < frameCount; ++frame)
+        {
+            const auto start = Clock::now();
+            stats.reset();
+
+            scene.update(1.0f / 60.0f);
+
+            glViewport(0, 0, width, height);
+            glClearColor(0, 0.5, 1, 1);
+            glClear(GL_COLOR_BUFFER_BIT);
+            glEnable(GL_BLEND);
+            glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+            glEnable(GL_SCISSOR_TEST);
+            scene.render(painter);
+            glDisable(GL_SCISSOR_TEST);
+            glFinish();
+
+            frameTimes.push_back(std::chrono::duration<double, std::milli>(Clock::now() - start).count());
+
+            if (stats.bytesUploaded > 0)
+                ++uploadFrames;
+            bytesUploaded += stats.bytesUploaded;
+            uploadTime += stats.uploadTime;
+        }
+
+        const auto firstFrame = frameTimes.front();
+        std::sort(frameTimes.begin(), frameTimes.end());
+        const auto percentile = [&frameTimes](double p) {
+            const auto index = static_cast<std::size_t>(p * (frameTimes.size() - 1) + 0.5);
+            return frameTimes[index];
+        };
+        log("Frames: %d, first %.3f ms\n", frameCount, firstFrame);
+        log("Uploads: %zu bytes in %.3f ms over %d frames\n", bytesUploaded, uploadTime, uploadFrames);
+        if (const auto &eviction = System::instance()->fontCache()->evictionStats(); eviction.passes > 0)
+            log("Glyph eviction: %d passes, %zu glyphs evicted\n", eviction.passes, eviction.glyphsEvicted);
+        log("Frame time (ms): p50 %.3f  p90 %.3f  p99 %.3f  max %.3f\n", percentile(0.5), percentile(0.9),
+            percentile(0.99), frameTimes.back());
+    }
+
+    System::shutdown();
+}
@@ -14,6 +14,8 @@ GLenum toGLTarget(Buffer::Type type)
         return GL_ARRAY_BUFFER;
     case Buffer::Type::Index:
         return GL_ELEMENT_ARRAY_BUFFER;
+    case Buffer::Type::PixelUnpack:
+        return GL_PIXEL_UNPACK_BUFFER;
     }
 }
 
@@ -49,6 +51,11 @@ void Buffer::bind() const
     glBindBuffer(m_type, m_handle);
 }
 
+void Buffer::unbind() const
+{
+    glBindBuffer(m_type, 0);
+}
+
 void Buffer::allocate(std::size_t size) const
 {
     allocate(size, nullptr);
@@ -69,4 +76,15 @@ void Buffer::write(std::size_t offset, std::span<const std::byte> data) const
     glBufferSubData(m_type, offset, data.size(), data.data());
 }
 
+std::byte *Buffer::map(std::size_t offset, std::size_t size) const
+{
+    constexpr GLbitfield Access = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT;
+    return static_cast<std::byte *>(glMapBufferRange(m_type, offset, size, Access));
+}
+
+void Buffer::unmap() const
+{
+    glUnmapBuffer(m_type);
+}
+
 } // namespace gl
@@ -13,7 +13,8 @@ public:
     enum class Type
     {
         Vertex,
-        Index
+        Index,
+        PixelUnpack,
     };
 
     enum class Usage
@@ -27,10 +28,15 @@ public:
     ~Buffer();
 
     void bind() const;
+    void unbind() const;
     void allocate(std::size_t size) const;
     void allocate(std::span<const std::byte> data) const;
     void write(std::size_t offset, std::span<const std::byte> data) const;
 
+    // Write-only and unsynchronized: the caller makes sure the GPU is done with the range.
+    std::byte *map(std::size_t offset, std::size_t size) const;
+    void unmap() const;
+
     GLuint handle() const { return m_handle; }
 
 private:
@@ -1,119 +1,479 @@
 #include "font.h"
 
-#include "ioutil.h"
 #include "pixmap.h"
 #include "log.h"
+#include "outlinerasterizer.h"
 #include "system.h"
+#include "trace.h"
+#include "workerpool.h"
+
+#include <algorithm>
+#include <iterator>
 
 namespace miniui
 {
 
-Font::Font(TextureAtlas *textureAtlas)
-    : m_textureAtlas(textureAtlas)
+namespace
 {
+constexpr auto GlyphBorder = 1; // cleared, around coverage glyphs
 }
 
-Font::~Font() = default;
-
-bool Font::load(const std::string &ttfPath, int pixelHeight)
+Font::Font(TextureAtlas *textureAtlas, const FontFace *face, int pixelHeight)
+    : m_textureAtlas(textureAtlas)
+    , m_face(face)
+    , m_pixelHeight(pixelHeight)
 {
-    log("Loading font %s:%d\n", ttfPath.c_str(), pixelHeight);
-
-    auto buffer = Util::readFile(ttfPath);
-    if (!buffer)
-        return false;
-
-    m_ttfBuffer = std::move(*buffer);
-
-    int result = stbtt_InitFont(&m_font, m_ttfBuffer.data(), stbtt_GetFontOffsetForIndex(m_ttfBuffer.data(), 0));
-    if (result == 0)
-    {
-        return false;
-    }
-
-    m_scale = stbtt_ScaleForPixelHeight(&m_font, pixelHeight);
+    m_scale = stbtt_ScaleForPixelHeight(m_face->info(), pixelHeight);
 
     int ascent;
     int descent;
     int lineGap;
-    stbtt_GetFontVMetrics(&m_font, &ascent, &descent, &lineGap);
+    stbtt_GetFontVMetrics(m_face->info(), &ascent, &descent, &lineGap);
     m_ascent = m_scale * ascent;
     m_descent = m_scale * descent;
     m_lineGap = m_scale * lineGap;
+    m_faces.push_back(Face{m_face, m_scale, {}});
+}
+
+Font::Font(Font *source, int pixelHeight)
+    : m_textureAtlas(source->m_textureAtlas)
+    , m_face(source->m_face)
+    , m_sdfSource(source)
+    , m_sdf(true)
+    , m_pixelHeight(pixelHeight)
+{
+    const auto scale = static_cast<float>(pixelHeight) / source->m_pixelHeight;
+    m_scale = scale * source->m_scale;
+    m_ascent = scale * source->m_ascent;
+    m_descent = scale * source->m_descent;
+    m_lineGap = scale * source->m_lineGap;
+}
 
-    m_pixelHeight = pixelHeight;
+Font::~Font()
+{
+    // the jobs refer to this font
+    std::unique_lock lock(m_rasterizedMutex);
+    m_jobFinished.wait(lock, [this] { return m_jobsInFlight == 0; });
+}
+
+void Font::setFallbacks(std::vector<FaceLoader> loaders)
+{
+    m_faces.resize(1);
+    for (auto &loader : loaders)
+        m_faces.push_back(Face{nullptr, 0.0f, std::move(loader)});
+}
+
+// The first face in the chain with a glyph for the codepoint, loading fallbacks on the way. -1 if none has one.
+int Font::resolveFace(int codepoint)
+{
+    for (std::size_t i = 0; i < m_faces.size(); ++i)
+    {
+        auto &face = m_faces[i];
+        if (face.load)
+        {
+            TRACE_ZONE("Font::loadFallback");
+            face.face = std::exchange(face.load, nullptr)();
+            if (face.face)
+                face.scale = stbtt_ScaleForPixelHeight(face.face->info(), m_pixelHeight);
+        }
+        if (face.face && stbtt_FindGlyphIndex(face.face->info(), codepoint))
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+// The face to rasterize a glyph from. Shifted variants take their codepoint's face, codepoints no face has get the
+// font's own .notdef glyph.
+int Font::glyphFace(int key)
+{
+    if (!hasFallbacks())
+        return 0;
+    if (key >> PhaseShift)
+    {
+        // unless the glyph came from the atlas cache, and its face hasn't been loaded yet
+        if (const auto *entry = m_glyphs.find(key & CodepointMask);
+            entry && entry->value && m_faces[entry->value->face].face)
+            return entry->value->face;
+    }
+    return std::max(0, resolveFace(key & CodepointMask));
+}
 
-    return true;
+float Font::fallbackKerning(int left, int right) const
+{
+    const auto *leftEntry = m_glyphs.find(left);
+    const auto *rightEntry = m_glyphs.find(right);
+    if (!leftEntry || !leftEntry->value || !rightEntry || !rightEntry->value ||
+        leftEntry->value->face != rightEntry->value->face)
+        return 0.0f;
+    // faces restored from the atlas cache may not be loaded
+    const auto &face = faces()[leftEntry->value->face];
+    if (!face.face || !face.face->hasKerning())
+        return 0.0f;
+    const auto scale = m_scale / faces().front().scale * face.scale;
+    if (FontFace::isDirectKerningPair(left, right))
+        return scale * face.face->directKerning(left, right);
+    return scale * face.face->kerning(leftEntry->value->index, rightEntry->value->index);
 }
 
-const Font::Glyph *Font::glyph(int codepoint)
+const Font::Glyph *Font::createGlyph(int codepoint)
 {
-    auto it = m_glyphs.find(codepoint);
-    if (it == m_glyphs.end())
-        it = m_glyphs.insert(it, {codepoint, initializeGlyph(codepoint)});
-    return it->second.get();
+    std::optional<Glyph> glyph;
+    if (m_workerPool && !m_sdfSource)
+    {
+        const auto face = glyphFace(codepoint);
+        glyph = glyphMetrics(codepoint, face);
+        glyph->pending = true;
+        rasterizeAsync({{codepoint, face}}, UploadPriority::High);
+    }
+    else
+    {
+        glyph = initializeGlyph(codepoint);
+    }
+    if (glyph && glyph->pending)
+        ++m_pendingCount;
+    auto &entry = m_glyphs.insert(codepoint, std::move(glyph));
+    return entry.value ? &*entry.value : nullptr;
 }
 
 float Font::textWidth(std::u32string_view text)
 {
     float width = 0.0f;
+    char32_t previous = 0;
     for (auto ch : text)
     {
         if (const auto *g = glyph(ch); g)
+        {
+            if (previous)
+                width += kerning(previous, ch);
             width += g->advanceWidth;
+            previous = ch;
+        }
     }
     return width;
 }
 
-std::unique_ptr<Font::Glyph> Font::initializeGlyph(int codepoint)
+void Font::prewarm(std::u32string_view codepoints)
 {
-    int ix0, iy0, ix1, iy1;
-    stbtt_GetCodepointBitmapBox(&m_font, codepoint, m_scale, m_scale, &ix0, &iy0, &ix1, &iy1);
+    TRACE_ZONE("Font::prewarm");
+
+    if (m_sdfSource)
+    {
+        // rasterizing happens in the source, the copies here are cheap
+        m_sdfSource->prewarm(codepoints);
+        for (const auto codepoint : codepoints)
+            glyph(codepoint);
+        return;
+    }
+
+    std::vector<int> missing(codepoints.begin(), codepoints.end());
+    std::sort(missing.begin(), missing.end());
+    missing.erase(std::unique(missing.begin(), missing.end()), missing.end());
+    std::erase_if(missing, [this](int codepoint) { return m_glyphs.find(codepoint) != nullptr; });
+    if (missing.empty())
+        return;
+
+    std::vector<std::pair<int, int>> faces;
+    faces.reserve(missing.size());
+    for (const auto codepoint : missing)
+        faces.emplace_back(codepoint, glyphFace(codepoint));
+
+    if (m_workerPool)
+    {
+        for (const auto &[codepoint, face] : faces)
+        {
+            auto glyph = glyphMetrics(codepoint, face);
+            glyph.pending = true;
+            m_glyphs.insert(codepoint, glyph);
+        }
+        m_pendingCount += missing.size();
+        const auto jobSize = (faces.size() + m_workerPool->threadCount() - 1) / m_workerPool->threadCount();
+        for (auto it = faces.begin(); it != faces.end();)
+        {
+            const auto end = it + std::min<std::size_t>(jobSize, faces.end() - it);
+            rasterizeAsync(std::vector<std::pair<int, int>>(it, end), UploadPriority::Low);
+            it = end;
+        }
+        return;
+    }
+
+    std::vector<Glyph> glyphs(missing.size());
+    std::vector<Pixmap> pixmaps;
+    pixmaps.reserve(missing.size());
+    for (std::size_t i = 0; i < missing.size(); ++i)
+        pixmaps.push_back(rasterizeGlyph(missing[i], faces[i].second, glyphs[i]));
+
+    std::vector<const Pixmap *> sources;
+    sources.reserve(pixmaps.size());
+    for (const auto &pixmap : pixmaps)
+        sources.push_back(&pixmap);
+    const auto packedPixmaps = m_textureAtlas->addPixmaps(sources, UploadPriority::Low);
+
+    for (std::size_t i = 0; i < missing.size(); ++i)
+    {
+        if (!packedPixmaps[i])
+        {
+            log("Couldn't fit glyph %d in texture atlas\n", missing[i]);
+            m_glyphs.insert(missing[i], std::nullopt);
+        }
+        else
+        {
+            glyphs[i].pixmap = *packedPixmaps[i];
+            m_glyphs.insert(missing[i], glyphs[i]);
+        }
+    }
+}
+
+void Font::prewarm(std::span<const CodepointRange> ranges)
+{
+    // Only what the font's own face covers: asking the fallbacks would load every one of them for a wide range. They
+    // still get their glyphs when those are first drawn.
+    std::u32string codepoints;
+    for (const auto &range : ranges)
+    {
+        for (auto codepoint = range.first; codepoint <= range.last; ++codepoint)
+        {
+            if (stbtt_FindGlyphIndex(m_face->info(), codepoint))
+                codepoints.push_back(codepoint);
+        }
+    }
+    prewarm(codepoints);
+}
 
-    const auto width = ix1 - ix0;
-    const auto height = iy1 - iy0;
+void Font::addRasterizedGlyphs()
+{
+    if (m_pendingCount == 0)
+        return;
+
+    if (m_sdfSource)
+    {
+        // the source has been given its glyphs already (see FontCache::beginFrame), copy the ones that are done
+        for (auto &[codepoint, glyph] : m_glyphs)
+        {
+            if (!glyph || !glyph->pending)
+                continue;
+            if (const auto *source = m_sdfSource->m_glyphs.find(codepoint);
+                source && source->value && source->value->pending)
+                continue;
+            --m_pendingCount;
+            const auto lastUsedFrame = glyph->lastUsedFrame;
+            glyph = initializeGlyph(codepoint);
+            if (glyph)
+                glyph->lastUsedFrame = lastUsedFrame;
+            else
+                ++m_generation;
+        }
+        return;
+    }
+
+    std::vector<RasterizedGlyph> rasterized;
+    {
+        std::lock_guard lock(m_rasterizedMutex);
+        rasterized.swap(m_rasterized);
+    }
+    if (rasterized.empty())
+        return;
 
-    std::vector<unsigned char> pixels;
-    pixels.resize(width * height);
-    stbtt_MakeCodepointBitmap(&m_font, pixels.data(), width, height, width, m_scale, m_scale, codepoint);
+    TRACE_ZONE("Font::addRasterizedGlyphs");
 
-    constexpr auto Border = 1;
+    for (const auto priority : {UploadPriority::High, UploadPriority::Low})
+    {
+        std::vector<RasterizedGlyph *> batch;
+        std::vector<const Pixmap *> sources;
+        for (auto &glyph : rasterized)
+        {
+            if (glyph.priority != priority)
+                continue;
+            batch.push_back(&glyph);
+            sources.push_back(&glyph.pixmap);
+        }
+        if (batch.empty())
+            continue;
+
+        const auto packedPixmaps = m_textureAtlas->addPixmaps(sources, priority);
+        for (std::size_t i = 0; i < batch.size(); ++i)
+        {
+            // pending glyphs are never evicted, the entry is still there
+            auto &slot = m_glyphs.find(batch[i]->codepoint)->value;
+            --m_pendingCount;
+            if (!packedPixmaps[i])
+            {
+                log("Couldn't fit glyph %d in texture atlas\n", batch[i]->codepoint);
+                slot.reset();
+                ++m_generation;
+                continue;
+            }
+            const auto lastUsedFrame = slot->lastUsedFrame;
+            slot = batch[i]->glyph;
+            slot->pixmap = *packedPixmaps[i];
+            slot->lastUsedFrame = lastUsedFrame;
+        }
+    }
+}
 
-    Pixmap pixmap;
-    pixmap.width = width + 2 * Border;
-    pixmap.height = height + 2 * Border;
-    pixmap.pixelType = PixelType::Grayscale;
-    pixmap.pixels.resize(pixmap.width * pixmap.height);
-    std::fill(pixmap.pixels.begin(), pixmap.pixels.end(), 0);
-    for (int i = 0; i < height; ++i)
+std::optional<Font::Glyph> Font::initializeGlyph(int codepoint)
+{
+    TRACE_ZONE("Font::initializeGlyph");
+
+    if (m_sdfSource)
     {
-        const auto *src = pixels.data() + i * width;
-        auto *dest = pixmap.pixels.data() + (i + Border) * pixmap.width + Border;
-        std::copy(src, src + width, dest);
+        const auto *source = m_sdfSource->glyph(codepoint);
+        if (!source)
+            return std::nullopt;
+        const auto scale = static_cast<float>(m_pixelHeight) / m_sdfSource->m_pixelHeight;
+        auto glyph = *source;
+        glyph.boundingBox = RectF{scale * source->boundingBox.min, scale * source->boundingBox.max};
+        glyph.advanceWidth = scale * source->advanceWidth;
+        glyph.lastUsedFrame = -1;
+        return glyph;
     }
 
-    auto packedPixmap = m_textureAtlas->addPixmap(pixmap);
-    if (!packedPixmap)
+    const auto face = glyphFace(codepoint);
+    if (m_sdf)
+    {
+        // stb allocates the distance field itself
+        Glyph glyph;
+        const auto pixmap = rasterizeSdfGlyph(codepoint, face, glyph);
+        auto packedPixmap = m_textureAtlas->addPixmap(pixmap);
+        if (!packedPixmap)
+        {
+            log("Couldn't fit glyph %d in texture atlas\n", codepoint);
+            return std::nullopt;
+        }
+        glyph.pixmap = *packedPixmap;
+        return glyph;
+    }
+
+    // rasterized straight into the atlas page, whose reserved space is cleared already, border included
+    auto glyph = glyphMetrics(codepoint, face);
+    const auto size = glm::ivec2(glyph.boundingBox.max - glyph.boundingBox.min);
+    const auto reservation = m_textureAtlas->reserve(size.x, size.y);
+    if (!reservation)
     {
         log("Couldn't fit glyph %d in texture atlas\n", codepoint);
-        return {};
+        return std::nullopt;
+    }
+    rasterizeCoverage(codepoint, face, reservation->pixels + GlyphBorder * reservation->stride + GlyphBorder,
+                      size.x - 2 * GlyphBorder, size.y - 2 * GlyphBorder, reservation->stride);
+    m_textureAtlas->commit(*reservation);
+    glyph.pixmap = reservation->packedPixmap;
+    return glyph;
+}
+
+// The metrics rasterizeGlyph() comes up with, without rasterizing. The bounding box includes the border.
+Font::Glyph Font::glyphMetrics(int key, int face) const
+{
+    const auto codepoint = key & CodepointMask;
+    const auto shift = static_cast<float>(key >> PhaseShift) / SubpixelPhases;
+    const auto *info = m_faces[face].face->info();
+    const auto scale = m_faces[face].scale;
+
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetCodepointBitmapBoxSubpixel(info, codepoint, scale, scale, shift, 0.0f, &ix0, &iy0, &ix1, &iy1);
+
+    Glyph glyph;
+    if (m_sdf && (ix0 == ix1 || iy0 == iy1))
+    {
+        glyph.boundingBox = RectF{glm::vec2(0), glm::vec2(0)}; // no outline, no distance field either
+    }
+    else
+    {
+        const auto border = m_sdf ? SdfPadding : GlyphBorder;
+        glyph.boundingBox = RectF{glm::vec2(ix0 - border, iy0 - border), glm::vec2(ix1 + border, iy1 + border)};
     }
 
     int advanceWidth, leftSideBearing;
-    stbtt_GetCodepointHMetrics(&m_font, codepoint, &advanceWidth, &leftSideBearing);
-
-    ix0 -= Border;
-    ix1 += Border;
-    iy0 -= Border;
-    iy1 += Border;
-    assert(packedPixmap->width == ix1 - ix0);
-    assert(packedPixmap->height == iy1 - iy0);
-
-    auto glyph = std::make_unique<Glyph>();
-    glyph->boundingBox = RectI{{ix0, iy0}, {ix1, iy1}};
-    glyph->advanceWidth = m_scale * advanceWidth;
-    glyph->pixmap = *packedPixmap;
+    stbtt_GetCodepointHMetrics(info, codepoint, &advanceWidth, &leftSideBearing);
+    glyph.advanceWidth = scale * advanceWidth;
+    glyph.face = face;
+    glyph.index = stbtt_FindGlyphIndex(info, codepoint);
     return glyph;
 }
 
+void Font::rasterizeAsync(std::vector<std::pair<int, int>> glyphs, UploadPriority priority)
+{
+    {
+        std::lock_guard lock(m_rasterizedMutex);
+        ++m_jobsInFlight;
+    }
+    // faces are resolved, and loaded, on the main thread
+    m_workerPool->post([this, requests = std::move(glyphs), priority] {
+        TRACE_ZONE("Font::rasterizeAsync");
+        std::vector<RasterizedGlyph> glyphs;
+        glyphs.reserve(requests.size());
+        for (const auto &[codepoint, face] : requests)
+        {
+            auto &glyph = glyphs.emplace_back(RasterizedGlyph{codepoint, priority, {}, {}});
+            glyph.pixmap = rasterizeGlyph(codepoint, face, glyph.glyph);
+        }
+
+        std::lock_guard lock(m_rasterizedMutex);
+        std::move(glyphs.begin(), glyphs.end(), std::back_inserter(m_rasterized));
+        --m_jobsInFlight;
+        m_jobFinished.notify_all();
+    });
+}
+
+// Fills in the glyph metrics and returns its bitmap, with a cleared border. Runs on worker threads too.
+Pixmap Font::rasterizeGlyph(int codepoint, int face, Glyph &glyph) const
+{
+    if (m_sdf)
+        return rasterizeSdfGlyph(codepoint, face, glyph);
+
+    glyph = glyphMetrics(codepoint, face);
+    const auto size = glm::ivec2(glyph.boundingBox.max - glyph.boundingBox.min);
+    Pixmap pixmap(size.x, size.y, PixelType::Grayscale);
+    rasterizeCoverage(codepoint, face, pixmap.pixels.data() + GlyphBorder * pixmap.width + GlyphBorder,
+                      size.x - 2 * GlyphBorder, size.y - 2 * GlyphBorder, pixmap.width);
+    return pixmap;
+}
+
+// Writes the coverage bitmap of the glyph, `stride` bytes per row. Leaves the border alone.
+void Font::rasterizeCoverage(int key, int face, unsigned char *pixels, int width, int height, int stride) const
+{
+    const auto codepoint = key & CodepointMask;
+    const auto shift = static_cast<float>(key >> PhaseShift) / SubpixelPhases;
+    const auto *info = m_faces[face].face->info();
+    const auto scale = m_faces[face].scale;
+    if (m_rasterizer == Rasterizer::Accumulation)
+    {
+        // one per thread, workers included, so that the accumulation buffer is reused
+        thread_local OutlineRasterizer rasterizer;
+        rasterizer.rasterizeCodepoint(info, codepoint, scale, shift, pixels, width, height, stride);
+    }
+    else
+    {
+        stbtt_MakeCodepointBitmapSubpixel(info, pixels, width, height, stride, scale, scale, shift, 0.0f, codepoint);
+    }
+}
+
+Pixmap Font::rasterizeSdfGlyph(int codepoint, int face, Glyph &glyph) const
+{
+    // the padding also serves as the cleared border
+    constexpr unsigned char OnEdgeValue = 128;
+    constexpr auto DistanceScale = static_cast<float>(OnEdgeValue) / SdfPadding;
+    const auto *info = m_faces[face].face->info();
+    const auto scale = m_faces[face].scale;
+
+    int width = 0, height = 0, xoff = 0, yoff = 0;
+    auto *pixels = stbtt_GetCodepointSDF(info, scale, codepoint, SdfPadding, OnEdgeValue, DistanceScale, &width,
+                                         &height, &xoff, &yoff);
+
+    // whitespace has no outline, and no bitmap
+    Pixmap pixmap(width, height, PixelType::Grayscale);
+    if (pixels)
+    {
+        std::copy(pixels, pixels + width * height, pixmap.pixels.begin());
+        stbtt_FreeSDF(pixels, nullptr);
+    }
+
+    int advanceWidth, leftSideBearing;
+    stbtt_GetCodepointHMetrics(info, codepoint, &advanceWidth, &leftSideBearing);
+
+    glyph.boundingBox = RectF{glm::vec2(xoff, yoff), glm::vec2(xoff + width, yoff + height)};
+    glyph.advanceWidth = scale * advanceWidth;
+    glyph.face = face;
+    glyph.index = stbtt_FindGlyphIndex(info, codepoint);
+    return pixmap;
+}
+
 } // namespace miniui
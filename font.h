@@ -1,17 +1,27 @@
 #pragma once
 
+#include "fontface.h"
+#include "glyphmap.h"
+#include "pixmap.h"
 #include "textureatlas.h"
 #include "util.h"
 
 #include <glm/glm.hpp>
-#include <stb_truetype.h>
 
+#include <condition_variable>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <span>
 #include <string>
-#include <unordered_map>
 #include <memory>
 #include <string_view>
+#include <utility>
+#include <vector>
 
-struct Pixmap;
+class WorkerPool;
 
 namespace miniui
 {
@@ -19,37 +29,189 @@ namespace miniui
 class Font
 {
 public:
-    explicit Font(TextureAtlas *textureAtlas);
+    // `face` is shared with the other sizes and must outlive the font (FontCache owns both).
+    Font(TextureAtlas *textureAtlas, const FontFace *face, int pixelHeight);
+    // A size variant of an SDF font: the glyphs are `source`'s, with metrics scaled to `pixelHeight`.
+    Font(Font *source, int pixelHeight);
     ~Font();
 
-    bool load(const std::string &ttfPath, int pixelHeight);
+    // Glyphs are signed distance fields rather than coverage: 0.5 on the outline, falling to 0 at SdfPadding pixels
+    // outside. Drawn with the SdfText program, at any size. Set before any glyph is created.
+    void setSdf(bool sdf) { m_sdf = sdf; }
+    bool isSdf() const { return m_sdf; }
+    const Font *sdfSource() const { return m_sdfSource; }
+
+    static constexpr auto SdfPadding = 6;
+
+    // Faces tried in order for codepoints the font's own face has no glyph for. Each is loaded by calling its loader
+    // the first time a codepoint gets past the faces before it (null if loading fails), so that large fallback fonts
+    // cost nothing until they're needed. The face a codepoint resolves to is kept with its glyph. Set before any glyph
+    // is created.
+    using FaceLoader = std::function<const FontFace *()>;
+    void setFallbacks(std::vector<FaceLoader> loaders);
+
+    // How coverage glyphs are rasterized. Set before any glyph is created.
+    enum class Rasterizer
+    {
+        Stb,          // stbtt_MakeCodepointBitmap
+        Accumulation, // OutlineRasterizer
+    };
+    void setRasterizer(Rasterizer rasterizer) { m_rasterizer = rasterizer; }
+    Rasterizer rasterizer() const { return m_rasterizer; }
+
+    // Coverage glyphs are drawn at quarter pixel positions rather than where the pen happens to be: each phase a glyph
+    // is drawn at is rasterized, with that shift, on first use (see glyph(int, int)). Ignored for SDF fonts.
+    void setSubpixelPositioning(bool enabled) { m_subpixelPositioning = enabled; }
+    bool subpixelPositioning() const { return m_subpixelPositioning && !m_sdf; }
+
+    static constexpr auto SubpixelPhases = 4;
+
+    // Splits a pen position into the pixel a glyph is drawn from and the nearest phase.
+    static std::pair<float, int> subpixelPosition(float x)
+    {
+        const auto quarters = static_cast<int>(std::floor(x * SubpixelPhases + 0.5f));
+        const auto pixel = std::floor(static_cast<float>(quarters) / SubpixelPhases);
+        return {pixel, quarters - static_cast<int>(pixel) * SubpixelPhases};
+    }
+
+    // Glyphs are rasterized on the pool's threads: a miss returns a pending glyph, with its metrics but no pixmap,
+    // which is filled in at the start of a later frame (see addRasterizedGlyphs). Null rasterizes synchronously.
+    void setWorkerPool(WorkerPool *pool) { m_workerPool = pool; }
 
     struct Glyph
     {
-        RectI boundingBox;
+        RectF boundingBox;
         float advanceWidth;
+        int face = 0;  // in the fallback chain, 0 is the font's own face
+        int index = 0; // in that face
+        bool pending = false; // still being rasterized, `pixmap` isn't set yet
         PackedPixmap pixmap;
+        mutable int lastUsedFrame = -1; // System::frameNumber() when last drawn
     };
-    const Glyph *glyph(int codepoint);
+    // Null if the font has no glyph for the codepoint, or it didn't fit in the atlas. Valid until the next glyph is
+    // created.
+    const Glyph *glyph(int codepoint)
+    {
+        if (const auto *entry = m_glyphs.find(codepoint))
+            return entry->value ? &*entry->value : nullptr;
+        return createGlyph(codepoint);
+    }
+    // The glyph shifted right by phase / SubpixelPhases of a pixel, phase 0 is glyph(codepoint). Same lifetime.
+    const Glyph *glyph(int codepoint, int phase)
+    {
+        return glyph(phase == 0 ? codepoint : codepoint | phase << PhaseShift);
+    }
+
+    // Like glyph(), but returns the glyph's slot in the font: a handle that stays valid until generation() changes.
+    // -1 if there's no glyph.
+    int glyphSlot(int codepoint)
+    {
+        if (!glyph(codepoint))
+            return -1;
+        return m_glyphs.indexOf(codepoint);
+    }
+    const Glyph &glyphAt(int slot) const { return *m_glyphs[slot].value; }
+
+    // Creates the glyphs that don't exist yet as one batch, packed together and uploaded at low priority. With a
+    // worker pool, the batch is split between its threads and the glyphs are pending until they're done.
+    void prewarm(std::u32string_view codepoints);
+
+    struct CodepointRange
+    {
+        char32_t first;
+        char32_t last; // inclusive
+    };
+    void prewarm(std::span<const CodepointRange> ranges);
+
+    // Moves the glyphs rasterized by the worker pool since the last call into the atlas. Called at the start of each
+    // frame (see FontCache::beginFrame).
+    void addRasterizedGlyphs();
+
+    // Bumped whenever glyphs are evicted or moved in the atlas, or a pending glyph turns out not to fit, invalidating
+    // Glyph pointers and copies.
+    int generation() const { return m_generation; }
 
     int pixelHeight() const { return m_pixelHeight; }
+    std::uint64_t contentHash() const { return m_face->contentHash(); } // of the TTF file
     float ascent() const { return m_ascent; }
     float descent() const { return m_descent; }
     float lineGap() const { return m_lineGap; }
     float textWidth(std::u32string_view text);
 
+    // Adjustment to the advance between two glyphs, both of which must have been created already. Glyphs from
+    // different faces aren't kerned.
+    float kerning(int left, int right) const
+    {
+        if (hasFallbacks())
+            return fallbackKerning(left, right);
+        if (!m_face->hasKerning())
+            return 0.0f;
+        if (FontFace::isDirectKerningPair(left, right))
+            return m_scale * m_face->directKerning(left, right);
+        const auto *leftEntry = m_glyphs.find(left);
+        const auto *rightEntry = m_glyphs.find(right);
+        if (!leftEntry || !leftEntry->value || !rightEntry || !rightEntry->value)
+            return 0.0f;
+        return m_scale * m_face->kerning(leftEntry->value->index, rightEntry->value->index);
+    }
+
 private:
-    std::unique_ptr<Glyph> initializeGlyph(int codepoint);
+    friend class FontCache; // evicts glyphs
+
+    // glyph keys are the codepoint, plus the subpixel phase above the largest codepoint
+    static constexpr auto PhaseShift = 21;
+    static constexpr auto CodepointMask = (1 << PhaseShift) - 1;
+
+    struct Face
+    {
+        const FontFace *face; // null until loaded, or if loading failed
+        float scale;
+        FaceLoader load;      // reset once called
+    };
+
+    // SDF size variants share their source's chain
+    const std::vector<Face> &faces() const { return m_sdfSource ? m_sdfSource->m_faces : m_faces; }
+    bool hasFallbacks() const { return faces().size() > 1; }
+    float fallbackKerning(int left, int right) const;
+    int resolveFace(int codepoint);
+    int glyphFace(int key);
+
+    const Glyph *createGlyph(int codepoint);
+    std::optional<Glyph> initializeGlyph(int codepoint);
+    Glyph glyphMetrics(int key, int face) const;
+    void rasterizeAsync(std::vector<std::pair<int, int>> glyphs, UploadPriority priority); // codepoint and face
+    Pixmap rasterizeGlyph(int codepoint, int face, Glyph &glyph) const;
+    Pixmap rasterizeSdfGlyph(int codepoint, int face, Glyph &glyph) const;
+    void rasterizeCoverage(int key, int face, unsigned char *pixels, int width, int height, int stride) const;
+
+    struct RasterizedGlyph
+    {
+        int codepoint;
+        UploadPriority priority;
+        Glyph glyph;
+        Pixmap pixmap;
+    };
 
     TextureAtlas *m_textureAtlas;
-    std::vector<unsigned char> m_ttfBuffer;
-    stbtt_fontinfo m_font;
-    std::unordered_map<int, std::unique_ptr<Glyph>> m_glyphs;
+    const FontFace *m_face;
+    std::vector<Face> m_faces; // m_face first, empty for SDF size variants
+    Font *m_sdfSource = nullptr;
+    bool m_sdf = false;
+    Rasterizer m_rasterizer = Rasterizer::Stb;
+    bool m_subpixelPositioning = false;
+    GlyphMap<Glyph> m_glyphs;
     int m_pixelHeight;
     float m_scale = 0.0f;
     float m_ascent;
     float m_descent;
     float m_lineGap;
+    int m_generation = 0;
+    WorkerPool *m_workerPool = nullptr;
+    int m_pendingCount = 0;
+    std::mutex m_rasterizedMutex;
+    std::condition_variable m_jobFinished;
+    std::vector<RasterizedGlyph> m_rasterized; // guarded by m_rasterizedMutex
+    int m_jobsInFlight = 0;                    // guarded by m_rasterizedMutex
 };
 
 } // namespace miniui
@@ -1,8 +1,14 @@
 #include "fontcache.h"
 
 #include "log.h"
+#include "trace.h"
+#include "workerpool.h"
 
+#include <algorithm>
+#include <chrono>
 #include <cstddef>
+#include <optional>
+#include <vector>
 
 namespace miniui
 {
@@ -13,6 +19,10 @@ std::string fontPath(std::string_view basename)
 {
     return std::string("assets/fonts/") + std::string(basename) + std::string(".ttf");
 }
+
+// Survivors of an eviction pass fill at most this fraction of the page budget, so that passes don't follow each
+// other closely.
+constexpr auto TargetOccupancy = 0.5f;
 } // namespace
 
 FontCache::FontCache(TextureAtlas *textureAtlas)
@@ -36,16 +46,263 @@ Font *FontCache::font(std::string_view name, int pixelHeight)
     auto it = m_fonts.find(key);
     if (it == m_fonts.end())
     {
-        auto font = std::make_unique<Font>(m_textureAtlas);
+        std::unique_ptr<Font> font;
+        if (!m_sdfGlyphs)
+            font = loadFont(key.name, pixelHeight, false);
+        else if (auto *source = sdfSource(key.name))
+            font = std::make_unique<Font>(source, pixelHeight);
+        it = m_fonts.emplace(std::move(key), std::move(font)).first;
+    }
+    return it->second.get();
+}
+
+void FontCache::setFallbacks(std::string_view fontName, std::vector<std::string> fallbackNames)
+{
+    m_fallbacks[std::string(fontName)] = std::move(fallbackNames);
+}
+
+void FontCache::setAsyncGlyphs(bool enabled)
+{
+    m_asyncGlyphs = enabled;
+    if (m_asyncGlyphs && !m_workerPool)
+        m_workerPool = std::make_unique<WorkerPool>();
+}
+
+const FontFace *FontCache::face(const std::string &name)
+{
+    auto it = m_faces.find(name);
+    if (it == m_faces.end())
+    {
         const auto path = fontPath(name);
-        if (!font->load(path, pixelHeight))
-        {
+        auto face = FontFace::load(path);
+        if (!face)
             log("Failed to load font %s\n", path.c_str());
-            font.reset();
+        it = m_faces.emplace(name, std::move(face)).first;
+    }
+    return it->second.get();
+}
+
+std::unique_ptr<Font> FontCache::loadFont(const std::string &name, int pixelHeight, bool sdf)
+{
+    const auto *fontFace = face(name);
+    if (!fontFace)
+        return {};
+    auto font = std::make_unique<Font>(m_textureAtlas, fontFace, pixelHeight);
+    font->setSdf(sdf);
+    font->setRasterizer(m_glyphRasterizer);
+    font->setSubpixelPositioning(m_subpixelGlyphs);
+    if (m_asyncGlyphs)
+        font->setWorkerPool(m_workerPool.get());
+    if (auto it = m_fallbacks.find(name); it != m_fallbacks.end())
+    {
+        std::vector<Font::FaceLoader> loaders;
+        for (const auto &fallback : it->second)
+            loaders.push_back([this, fallback] { return face(fallback); });
+        font->setFallbacks(std::move(loaders));
+    }
+
+    auto table = std::find_if(m_warmGlyphTables.begin(), m_warmGlyphTables.end(), [&](const auto &table) {
+        return table.name == name && table.pixelHeight == pixelHeight && table.sdf == sdf;
+    });
+    if (table != m_warmGlyphTables.end())
+    {
+        if (table->contentHash == glyphTableHash(name, *font))
+        {
+            for (const auto &[codepoint, glyph] : table->glyphs)
+            {
+                if (glyph.face < static_cast<int>(font->m_faces.size()) && !font->m_glyphs.find(codepoint))
+                    font->m_glyphs.insert(codepoint, glyph);
+            }
         }
-        it = m_fonts.emplace(std::move(key), std::move(font)).first;
+        m_warmGlyphTables.erase(table);
     }
+    return font;
+}
+
+Font *FontCache::sdfSource(const std::string &name)
+{
+    auto it = m_sdfSources.find(name);
+    if (it == m_sdfSources.end())
+        it = m_sdfSources.emplace(name, loadFont(name, SdfReferenceSize, true)).first;
     return it->second.get();
 }
 
+std::vector<FontCache::GlyphTable> FontCache::glyphTables() const
+{
+    std::vector<GlyphTable> tables;
+    const auto addTable = [this, &tables](const std::string &name, const Font &font) {
+        auto &table =
+            tables.emplace_back(GlyphTable{name, font.pixelHeight(), font.isSdf(), glyphTableHash(name, font), {}});
+        for (const auto &[codepoint, glyph] : font.m_glyphs)
+        {
+            if (glyph && !glyph->pending)
+                table.glyphs.emplace_back(codepoint, *glyph);
+        }
+    };
+    for (const auto &[key, font] : m_fonts)
+    {
+        // SDF size variants are derived from their source
+        if (font && !font->sdfSource())
+            addTable(key.name, *font);
+    }
+    for (const auto &[name, font] : m_sdfSources)
+    {
+        if (font)
+            addTable(name, *font);
+    }
+    return tables;
+}
+
+// Glyphs refer to their face by its place in the fallback chain, so a table is only good for the same chain. The
+// fallbacks are hashed by name: hashing their files would mean loading them.
+std::uint64_t FontCache::glyphTableHash(const std::string &name, const Font &font) const
+{
+    auto hash = font.contentHash();
+    if (auto it = m_fallbacks.find(name); it != m_fallbacks.end())
+    {
+        for (const auto &fallback : it->second)
+            hash = hash * 31 + std::hash<std::string>()(fallback);
+    }
+    return hash;
+}
+
+void FontCache::setWarmGlyphTables(std::vector<GlyphTable> tables)
+{
+    m_warmGlyphTables = std::move(tables);
+}
+
+void FontCache::beginFrame(int frame)
+{
+    m_frame = frame;
+
+    // SDF sources first, their size variants copy from them
+    for (auto &[name, font] : m_sdfSources)
+    {
+        if (font)
+            font->addRasterizedGlyphs();
+    }
+    for (auto &[key, font] : m_fonts)
+    {
+        if (font)
+            font->addRasterizedGlyphs();
+    }
+
+    // don't try again until the atlas grows, if all the glyphs were still in use last time
+    if (m_pageBudget > 0 && m_textureAtlas->pageCount() > std::max(m_pageBudget, m_pageCountAfterEviction))
+        evictGlyphs();
+}
+
+void FontCache::evictGlyphs()
+{
+    TRACE_ZONE("FontCache::evictGlyphs");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    struct Entry
+    {
+        std::optional<Font::Glyph> *slot;
+        Font::Glyph *glyph;
+    };
+    // Only fonts that own their atlas entries take part. SDF size variants hand their use over to the source
+    // glyphs and are rebuilt from them afterwards.
+    std::vector<Font *> owners;
+    std::vector<Font *> variants;
+    for (auto &[key, font] : m_fonts)
+    {
+        if (font)
+            (font->sdfSource() ? variants : owners).push_back(font.get());
+    }
+    for (auto &[name, font] : m_sdfSources)
+    {
+        if (font)
+            owners.push_back(font.get());
+    }
+    for (auto *variant : variants)
+    {
+        auto &sourceGlyphs = variant->m_sdfSource->m_glyphs;
+        for (const auto &[codepoint, glyph] : variant->m_glyphs)
+        {
+            auto *source = sourceGlyphs.find(codepoint);
+            if (glyph && source && source->value)
+                source->value->lastUsedFrame = std::max(source->value->lastUsedFrame, glyph->lastUsedFrame);
+        }
+    }
+
+    std::vector<Entry> entries;
+    for (auto *font : owners)
+    {
+        // pending glyphs aren't in the atlas yet
+        for (auto &[codepoint, glyph] : font->m_glyphs)
+        {
+            if (glyph && !glyph->pending)
+                entries.push_back({&glyph, &*glyph});
+        }
+    }
+    std::sort(entries.begin(), entries.end(),
+              [](const Entry &lhs, const Entry &rhs) { return lhs.glyph->lastUsedFrame > rhs.glyph->lastUsedFrame; });
+
+    // glyphs drawn last frame are kept no matter what, evicting them would only make them come right back
+    const auto pageArea = static_cast<std::size_t>(m_textureAtlas->pageWidth()) * m_textureAtlas->pageHeight();
+    const auto targetArea = static_cast<std::size_t>(TargetOccupancy * m_pageBudget * pageArea);
+    constexpr auto Margin = 2 * TextureAtlasPage::Margin;
+    std::size_t keptArea = 0;
+    bool full = false;
+    std::vector<PackedPixmap *> kept;
+    std::vector<std::optional<Font::Glyph> *> keptSlots;
+    std::size_t evicted = 0;
+    std::size_t lost = 0;
+    for (const auto &entry : entries)
+    {
+        const auto &pixmap = entry.glyph->pixmap;
+        const auto area = static_cast<std::size_t>(pixmap.width + Margin) * (pixmap.height + Margin);
+        full = full || keptArea + area > targetArea;
+        if (!full || entry.glyph->lastUsedFrame >= m_frame - 1)
+        {
+            kept.push_back(&entry.glyph->pixmap);
+            keptSlots.push_back(entry.slot);
+            keptArea += area;
+        }
+        else
+        {
+            entry.slot->reset();
+            ++evicted;
+        }
+    }
+
+    const auto pagesBefore = m_textureAtlas->pageCount();
+    if (evicted > 0)
+    {
+        // glyphs that don't fit anymore point at a page that's gone, they're evicted too and created again when drawn
+        for (const auto index : m_textureAtlas->repack(kept))
+        {
+            keptSlots[index]->reset();
+            ++lost;
+        }
+        // glyphs that didn't fit in the atlas before get another chance too
+        for (auto *font : owners)
+        {
+            font->m_glyphs.eraseIf([](const auto &entry) { return !entry.value; });
+            ++font->m_generation;
+        }
+        for (auto *variant : variants)
+        {
+            variant->m_glyphs.clear();
+            variant->m_pendingCount = 0;
+            ++variant->m_generation;
+        }
+    }
+    m_pageCountAfterEviction = m_textureAtlas->pageCount();
+
+    auto &stats = m_evictionStats;
+    ++stats.passes;
+    stats.glyphsEvicted += evicted + lost;
+    stats.glyphsKept = kept.size() - lost;
+    stats.pagesBefore = pagesBefore;
+    stats.pagesAfter = m_pageCountAfterEviction;
+    stats.lastPassTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+    log("Evicted %zu glyphs, kept %zu, font atlas pages %d -> %d (%.2f ms)\n", evicted + lost, kept.size() - lost,
+        pagesBefore, m_pageCountAfterEviction, stats.lastPassTime);
+}
+
 } // namespace miniui
@@ -5,12 +5,16 @@
 #include "font.h"
 
 #include <cstddef>
+#include <cstdint>
 #include <string_view>
 #include <string>
 #include <unordered_map>
 #include <memory>
+#include <utility>
+#include <vector>
 
 class TextureAtlas;
+class WorkerPool;
 
 namespace miniui
 {
@@ -24,8 +28,81 @@ public:
 
     Font *font(std::string_view fontName, int pixelHeight);
 
+    // Fonts requested from now on render signed distance fields (see Font::setSdf): each face is rasterized once,
+    // at SdfReferenceSize, and every size shares those glyphs.
+    void setSdfGlyphs(bool enabled) { m_sdfGlyphs = enabled; }
+    bool sdfGlyphs() const { return m_sdfGlyphs; }
+
+    static constexpr auto SdfReferenceSize = 48;
+
+    // Fonts requested from now on rasterize their coverage glyphs with this (see Font::setRasterizer).
+    void setGlyphRasterizer(Font::Rasterizer rasterizer) { m_glyphRasterizer = rasterizer; }
+    Font::Rasterizer glyphRasterizer() const { return m_glyphRasterizer; }
+
+    // Fonts named `fontName` requested from now on fall back to these fonts, in order, for codepoints they have no
+    // glyph for (see Font::setFallbacks). A fallback file is only loaded once a codepoint needs it.
+    void setFallbacks(std::string_view fontName, std::vector<std::string> fallbackNames);
+
+    // Fonts requested from now on draw coverage glyphs at quarter pixel positions (see Font::setSubpixelPositioning).
+    void setSubpixelGlyphs(bool enabled) { m_subpixelGlyphs = enabled; }
+    bool subpixelGlyphs() const { return m_subpixelGlyphs; }
+
+    // Fonts requested from now on rasterize glyph misses and prewarmed glyphs on a pool of background threads (see
+    // Font::setWorkerPool). Glyphs are then missing from the frame they are first drawn in, and maybe a few more.
+    void setAsyncGlyphs(bool enabled);
+    bool asyncGlyphs() const { return m_asyncGlyphs; }
+
+    // Once the atlas has more pages than this, the least recently drawn glyphs are evicted and the rest repacked.
+    // 0 means no limit.
+    void setPageBudget(int pages) { m_pageBudget = pages; }
+    int pageBudget() const { return m_pageBudget; }
+
+    // Called at the start of each frame, before anything is drawn (see System::beginFrame). Adds the glyphs
+    // rasterized since the last frame to the atlas.
+    void beginFrame(int frame);
+
+    struct EvictionStats
+    {
+        int passes = 0;
+        std::size_t glyphsEvicted = 0;
+        std::size_t glyphsKept = 0; // in the last pass
+        int pagesBefore = 0;        // in the last pass
+        int pagesAfter = 0;
+        double lastPassTime = 0.0; // in ms
+    };
+    const EvictionStats &evictionStats() const { return m_evictionStats; }
+
+    // Glyph tables for persisting the atlas (see AtlasCache). A warm table is installed when its font is first
+    // requested, if the font file still has the same content hash.
+    struct GlyphTable
+    {
+        std::string name;
+        int pixelHeight;
+        bool sdf;
+        std::uint64_t contentHash;
+        std::vector<std::pair<int, Font::Glyph>> glyphs;
+    };
+    std::vector<GlyphTable> glyphTables() const;
+    void setWarmGlyphTables(std::vector<GlyphTable> tables);
+
 private:
+    const FontFace *face(const std::string &name);
+    std::unique_ptr<Font> loadFont(const std::string &name, int pixelHeight, bool sdf);
+    Font *sdfSource(const std::string &name);
+    std::uint64_t glyphTableHash(const std::string &name, const Font &font) const;
+    void evictGlyphs();
+
     TextureAtlas *m_textureAtlas;
+    int m_pageBudget = 4;
+    bool m_sdfGlyphs = false;
+    bool m_asyncGlyphs = false;
+    Font::Rasterizer m_glyphRasterizer = Font::Rasterizer::Stb;
+    bool m_subpixelGlyphs = false;
+    int m_frame = 0;
+    int m_pageCountAfterEviction = 0;
+    EvictionStats m_evictionStats;
+    std::vector<GlyphTable> m_warmGlyphTables;
+    std::unordered_map<std::string, std::vector<std::string>> m_fallbacks; // by font name
     struct FontKey
     {
         std::string name;
@@ -36,7 +113,10 @@ private:
     {
         std::size_t operator()(const FontKey &key) const;
     };
+    std::unique_ptr<WorkerPool> m_workerPool;
+    std::unordered_map<std::string, std::unique_ptr<FontFace>> m_faces; // by name, declared first to outlive the fonts
     std::unordered_map<FontKey, std::unique_ptr<Font>, FontKeyHasher> m_fonts;
+    std::unordered_map<std::string, std::unique_ptr<Font>> m_sdfSources; // at SdfReferenceSize, by name
 };
 
 } // namespace miniui
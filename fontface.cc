@@ -0,0 +1,93 @@
+#include "fontface.h"
+
+#include "ioutil.h"
+#include "log.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <array>
+#include <numeric>
+
+namespace miniui
+{
+
+std::unique_ptr<FontFace> FontFace::load(const std::string &ttfPath)
+{
+    TRACE_ZONE("FontFace::load");
+
+    log("Loading font face %s\n", ttfPath.c_str());
+
+    std::unique_ptr<FontFace> face(new FontFace);
+    face->m_file = Util::MappedFile::open(ttfPath);
+    if (!face->m_file)
+        return {};
+
+    const auto *data = face->m_file->data().data();
+    const int offset = stbtt_GetFontOffsetForIndex(data, 0);
+    if (offset < 0 || stbtt_InitFont(&face->m_info, data, offset) == 0)
+        return {};
+
+    face->buildKerningTable();
+
+    return face;
+}
+
+FontFace::~FontFace() = default;
+
+void FontFace::buildKerningTable()
+{
+    TRACE_ZONE("FontFace::buildKerningTable");
+
+    const int length = stbtt_GetKerningTableLength(&m_info);
+    if (length == 0 && !m_info.gpos)
+        return;
+
+    std::vector<stbtt_kerningentry> entries(length);
+    stbtt_GetKerningTable(&m_info, entries.data(), length);
+    std::vector<std::size_t> order(entries.size());
+    std::iota(order.begin(), order.end(), 0);
+    const auto key = [&entries](std::size_t index) {
+        return static_cast<std::uint32_t>(entries[index].glyph1) << 16 | entries[index].glyph2;
+    };
+    std::sort(order.begin(), order.end(), [&key](std::size_t lhs, std::size_t rhs) { return key(lhs) < key(rhs); });
+    m_kerningPairs.reserve(entries.size());
+    m_kerningValues.reserve(entries.size());
+    for (const auto index : order)
+    {
+        if (entries[index].advance == 0)
+            continue;
+        m_kerningPairs.push_back(key(index));
+        m_kerningValues.push_back(entries[index].advance);
+    }
+
+    // GPOS pairs can't be listed through stb_truetype, so they are only looked up for the direct block
+    constexpr auto Size = DirectKerningEnd - DirectKerningBegin;
+    std::array<int, Size> glyphIndices;
+    for (int i = 0; i < Size; ++i)
+        glyphIndices[i] = stbtt_FindGlyphIndex(&m_info, DirectKerningBegin + i);
+    m_directKerning.resize(Size * Size);
+    for (int left = 0; left < Size; ++left)
+    {
+        for (int right = 0; right < Size; ++right)
+            m_directKerning[left * Size + right] =
+                stbtt_GetGlyphKernAdvance(&m_info, glyphIndices[left], glyphIndices[right]);
+    }
+}
+
+int FontFace::kerning(int leftGlyphIndex, int rightGlyphIndex) const
+{
+    const auto key = static_cast<std::uint32_t>(leftGlyphIndex) << 16 | static_cast<std::uint32_t>(rightGlyphIndex);
+    auto it = std::lower_bound(m_kerningPairs.begin(), m_kerningPairs.end(), key);
+    if (it == m_kerningPairs.end() || *it != key)
+        return 0;
+    return m_kerningValues[it - m_kerningPairs.begin()];
+}
+
+std::uint64_t FontFace::contentHash() const
+{
+    if (!m_contentHash)
+        m_contentHash = Util::contentHash(m_file->data());
+    return *m_contentHash;
+}
+
+} // namespace miniui
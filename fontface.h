@@ -0,0 +1,63 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <stb_truetype.h>
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace Util
+{
+class MappedFile;
+}
+
+namespace miniui
+{
+
+// A parsed TTF file, memory-mapped and read-only. FontCache keeps one per file, shared by every size of the font.
+class FontFace : private NonCopyable
+{
+public:
+    static std::unique_ptr<FontFace> load(const std::string &ttfPath);
+    ~FontFace();
+
+    const stbtt_fontinfo *info() const { return &m_info; }
+
+    // of the file, computed on first use so that faces that are never persisted don't read all of it
+    std::uint64_t contentHash() const;
+
+    // Kerning in font units, from a table built at load time. Pairs of printable ASCII characters are looked up
+    // directly by codepoint, any other pair by glyph index in the pairs of the kern table.
+    static constexpr int DirectKerningBegin = 0x20;
+    static constexpr int DirectKerningEnd = 0x7f;
+    static bool isDirectKerningPair(int left, int right)
+    {
+        return left >= DirectKerningBegin && left < DirectKerningEnd && right >= DirectKerningBegin &&
+               right < DirectKerningEnd;
+    }
+    bool hasKerning() const { return !m_directKerning.empty(); }
+    int directKerning(int left, int right) const
+    {
+        constexpr auto Size = DirectKerningEnd - DirectKerningBegin;
+        return m_directKerning[(left - DirectKerningBegin) * Size + right - DirectKerningBegin];
+    }
+    int kerning(int leftGlyphIndex, int rightGlyphIndex) const;
+
+private:
+    FontFace() = default;
+
+    void buildKerningTable();
+
+    std::unique_ptr<Util::MappedFile> m_file;
+    stbtt_fontinfo m_info;
+    mutable std::optional<std::uint64_t> m_contentHash;
+    std::vector<std::int16_t> m_directKerning; // empty if the font has no kerning
+    std::vector<std::uint32_t> m_kerningPairs; // left << 16 | right glyph index, sorted
+    std::vector<std::int16_t> m_kerningValues;
+};
+
+} // namespace miniui
@@ -2,6 +2,9 @@
 
 #include "texture.h"
 
+#include <algorithm>
+#include <vector>
+
 namespace gl
 {
 
@@ -32,6 +35,26 @@ void Framebuffer::bind() const
     glBindRenderbuffer(GL_RENDERBUFFER, m_rboId);
 }
 
+Pixmap Framebuffer::readPixels() const
+{
+    Pixmap pixmap(m_width, m_height, PixelType::RGBA);
+    const auto rowSize = m_width * 4;
+    std::vector<unsigned char> rows(rowSize * m_height);
+
+    bind();
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, m_width, m_height, GL_RGBA, GL_UNSIGNED_BYTE, rows.data());
+
+    // GL returns the bottom row first
+    for (int i = 0; i < m_height; ++i)
+    {
+        const auto *src = rows.data() + (m_height - 1 - i) * rowSize;
+        std::copy(src, src + rowSize, pixmap.pixels.data() + i * rowSize);
+    }
+
+    return pixmap;
+}
+
 void Framebuffer::unbind()
 {
     glBindRenderbuffer(GL_RENDERBUFFER, 0);
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "noncopyable.h"
+#include "pixmap.h"
 
 #include <GL/glew.h>
 
@@ -23,6 +24,8 @@ public:
     int width() const { return m_width; }
     int height() const { return m_height; }
 
+    Pixmap readPixels() const; // RGBA, top row first
+
 private:
     int m_width;
     int m_height;
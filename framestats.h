@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstddef>
+
+// Per-frame rendering counters. Reset by whoever owns the frame (the app loop or a test harness).
+struct FrameStats
+{
+    int flushes = 0;      // SpriteBatcher flushes that emitted at least one quad
+    int drawCalls = 0;    // glDrawArrays issued by the sprite batcher
+    int textureBinds = 0; // texture switches inside batches
+    int textureUploads = 0;             // LazyTexture regions sent to the GPU
+    std::size_t bytesUploaded = 0;
+    double uploadTime = 0.0;            // in ms, spent in the frame-start upload phase
+    std::size_t bytesPendingUpload = 0; // left over for later frames by the upload budget
+
+    void reset() { *this = FrameStats{}; }
+};
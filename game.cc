@@ -6,6 +6,7 @@
 #include "log.h"
 #include "system.h"
 #include "fontcache.h"
+#include "trace.h"
 
 #include <GL/glew.h>
 
@@ -27,6 +28,14 @@ Game::Game()
     auto *smallFont = fontCache->font("OpenSans_Regular", 32);
     auto *tinyFont = fontCache->font("OpenSans_Regular", 20);
 
+    // printable ASCII, packed as one batch per font
+    constexpr Font::CodepointRange PrewarmRanges[] = {{0x20, 0x7e}};
+    for (auto *font : {titleFont, smallFont, tinyFont})
+    {
+        if (font)
+            font->prewarm(PrewarmRanges);
+    }
+
     auto *container = static_cast<Container *>(m_item.get());
     container->fillBackground = true;
     container->backgroundColor = glm::vec4(1, 0, 0, 0.5);
@@ -191,6 +200,8 @@ void Game::resize(int width, int height)
 
 void Game::render()
 {
+    TRACE_ZONE("Game::render");
+
     glClearColor(0, 0.5, 1, 1);
     glViewport(0, 0, m_width, m_height);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
@@ -223,6 +234,8 @@ void Game::render()
 
 void Game::update(float elapsed)
 {
+    TRACE_ZONE("Game::update");
+
     m_time += elapsed;
 #if 0
     auto text = std::to_string(static_cast<int>(m_time * 10.0f));
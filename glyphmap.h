@@ -0,0 +1,159 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+// Codepoint to glyph map for text drawing. Entries are stored by value in one contiguous array, in insertion order.
+// Codepoints below DirectSize (Basic Latin through Latin Extended-B) are found with a single array index, the rest
+// through an open addressing table with linear probing.
+//
+// Pointers to entries are invalidated by insert() and eraseIf(), entry indices only by eraseIf() and clear().
+template<typename T>
+class GlyphMap
+{
+public:
+    static constexpr int DirectSize = 0x250;
+    static constexpr std::int32_t NotFound = -1;
+
+    struct Entry
+    {
+        int codepoint;
+        std::optional<T> value; // none: the codepoint has no glyph, don't try again
+    };
+
+    GlyphMap() { m_direct.fill(NotFound); }
+
+    // NotFound if the codepoint was never inserted
+    std::int32_t indexOf(int codepoint) const
+    {
+        if (codepoint >= 0 && codepoint < DirectSize)
+            return m_direct[codepoint];
+        if (m_slots.empty())
+            return NotFound;
+        const auto mask = m_slots.size() - 1;
+        for (auto i = hash(codepoint);; i = (i + 1) & mask)
+        {
+            const auto &slot = m_slots[i];
+            if (slot.index == NotFound || slot.codepoint == codepoint)
+                return slot.index;
+        }
+    }
+
+    const Entry &operator[](std::size_t index) const { return m_entries[index]; }
+
+    // null if the codepoint was never inserted
+    const Entry *find(int codepoint) const
+    {
+        const auto index = indexOf(codepoint);
+        return index == NotFound ? nullptr : &m_entries[index];
+    }
+
+    Entry *find(int codepoint)
+    {
+        const auto index = indexOf(codepoint);
+        return index == NotFound ? nullptr : &m_entries[index];
+    }
+
+    // `codepoint` must not be in the map yet
+    Entry &insert(int codepoint, std::optional<T> value)
+    {
+        const auto index = static_cast<std::int32_t>(m_entries.size());
+        if (codepoint >= 0 && codepoint < DirectSize)
+        {
+            m_direct[codepoint] = index;
+        }
+        else
+        {
+            // before the entry is added, rehash() would slot it already
+            if (2 * (m_hashedCount + 1) > m_slots.size())
+                rehash(std::max<std::size_t>(16, 2 * m_slots.size()));
+            insertSlot(codepoint, index);
+            ++m_hashedCount;
+        }
+        m_entries.push_back(Entry{codepoint, std::move(value)});
+        return m_entries.back();
+    }
+
+    template<typename Predicate>
+    void eraseIf(Predicate predicate)
+    {
+        std::erase_if(m_entries, predicate);
+        rebuildIndex();
+    }
+
+    void clear()
+    {
+        m_entries.clear();
+        rebuildIndex();
+    }
+
+    std::size_t size() const { return m_entries.size(); }
+
+    auto begin() { return m_entries.begin(); }
+    auto end() { return m_entries.end(); }
+    auto begin() const { return m_entries.begin(); }
+    auto end() const { return m_entries.end(); }
+
+private:
+    struct Slot
+    {
+        int codepoint;
+        std::int32_t index = NotFound; // NotFound for an empty slot
+    };
+
+    // Fibonacci hashing: the top bits of the product depend on every bit of the codepoint, so neighbouring codepoints
+    // of one script and the subpixel variants of one codepoint (see Font::PhaseShift) spread over the table.
+    std::size_t hash(int codepoint) const
+    {
+        return (static_cast<std::uint32_t>(codepoint) * 2654435769u) >> m_hashShift;
+    }
+
+    void insertSlot(int codepoint, std::int32_t index)
+    {
+        const auto mask = m_slots.size() - 1;
+        auto i = hash(codepoint);
+        while (m_slots[i].index != NotFound)
+            i = (i + 1) & mask;
+        m_slots[i] = Slot{codepoint, index};
+    }
+
+    void rehash(std::size_t capacity)
+    {
+        m_slots.assign(capacity, Slot{});
+        m_hashShift = capacity > 0 ? 32 - std::countr_zero(capacity) : 0;
+        for (std::size_t i = 0; i < m_entries.size(); ++i)
+        {
+            const auto codepoint = m_entries[i].codepoint;
+            if (codepoint < 0 || codepoint >= DirectSize)
+                insertSlot(codepoint, static_cast<std::int32_t>(i));
+        }
+    }
+
+    void rebuildIndex()
+    {
+        m_direct.fill(NotFound);
+        m_hashedCount = 0;
+        for (std::size_t i = 0; i < m_entries.size(); ++i)
+        {
+            const auto codepoint = m_entries[i].codepoint;
+            if (codepoint >= 0 && codepoint < DirectSize)
+                m_direct[codepoint] = static_cast<std::int32_t>(i);
+            else
+                ++m_hashedCount;
+        }
+        std::size_t capacity = 16;
+        while (2 * m_hashedCount > capacity)
+            capacity *= 2;
+        rehash(m_hashedCount > 0 ? capacity : 0);
+    }
+
+    std::vector<Entry> m_entries;
+    std::array<std::int32_t, DirectSize> m_direct;
+    std::vector<Slot> m_slots; // capacity is a power of two, at most half full
+    int m_hashShift = 0;       // 32 - log2(capacity), keeps the top bits of the hash product
+    std::size_t m_hashedCount = 0;
+};
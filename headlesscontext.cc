@@ -0,0 +1,35 @@
+#include "headlesscontext.h"
+
+#include "log.h"
+
+#include <GL/glew.h>
+#include <GLFW/glfw3.h>
+
+HeadlessContext::HeadlessContext(int width, int height)
+{
+    if (!glfwInit())
+    {
+        log("Failed to initialize GLFW\n");
+        return;
+    }
+
+    glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+    m_window = glfwCreateWindow(width, height, "headless", nullptr, nullptr);
+    if (!m_window)
+    {
+        log("Failed to create headless GL context\n");
+        return;
+    }
+
+    glfwMakeContextCurrent(m_window);
+    glewInit();
+
+    log("Renderer: %s\n", glGetString(GL_RENDERER));
+}
+
+HeadlessContext::~HeadlessContext()
+{
+    if (m_window)
+        glfwDestroyWindow(m_window);
+    glfwTerminate();
+}
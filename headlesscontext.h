@@ -0,0 +1,18 @@
+#pragma once
+
+#include "noncopyable.h"
+
+struct GLFWwindow;
+
+// Hidden GLFW window providing a current GL context, for tools that render without a visible window.
+class HeadlessContext : private NonCopyable
+{
+public:
+    explicit HeadlessContext(int width = 64, int height = 64);
+    ~HeadlessContext();
+
+    bool isValid() const { return m_window != nullptr; }
+
+private:
+    GLFWwindow *m_window = nullptr;
+};
@@ -2,6 +2,13 @@
 
 #include <fstream>
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 namespace Util
 {
 std::optional<std::vector<unsigned char>> readFile(const std::string &path)
@@ -23,4 +30,54 @@ std::optional<std::vector<unsigned char>> readFile(const std::string &path)
     return data;
 }
 
+std::unique_ptr<MappedFile> MappedFile::open(const std::string &path)
+{
+    std::unique_ptr<MappedFile> file(new MappedFile);
+#ifndef _WIN32
+    const int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return {};
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED)
+        {
+            file->m_data = static_cast<const unsigned char *>(data);
+            file->m_size = st.st_size;
+            file->m_mapped = true;
+        }
+    }
+    ::close(fd);
+    if (file->m_mapped)
+        return file;
+#endif
+    auto buffer = readFile(path);
+    if (!buffer)
+        return {};
+    file->m_buffer = std::move(*buffer);
+    file->m_data = file->m_buffer.data();
+    file->m_size = file->m_buffer.size();
+    return file;
+}
+
+MappedFile::~MappedFile()
+{
+#ifndef _WIN32
+    if (m_mapped)
+        munmap(const_cast<unsigned char *>(m_data), m_size);
+#endif
+}
+
+std::uint64_t contentHash(std::span<const unsigned char> data)
+{
+    std::uint64_t hash = 0xcbf29ce484222325ull;
+    for (const auto byte : data)
+    {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
 } // namespace Util
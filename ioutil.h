@@ -1,10 +1,37 @@
 #pragma once
 
+#include "noncopyable.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <optional>
+#include <span>
 #include <string>
 #include <vector>
 
 namespace Util
 {
 std::optional<std::vector<unsigned char>> readFile(const std::string &path);
-}
+
+// Read-only view of a whole file, memory-mapped where the platform allows it.
+class MappedFile : private NonCopyable
+{
+public:
+    static std::unique_ptr<MappedFile> open(const std::string &path);
+    ~MappedFile();
+
+    std::span<const unsigned char> data() const { return {m_data, m_size}; }
+
+private:
+    MappedFile() = default;
+
+    const unsigned char *m_data = nullptr;
+    std::size_t m_size = 0;
+    std::vector<unsigned char> m_buffer; // when the file couldn't be mapped
+    bool m_mapped = false;
+};
+
+// 64-bit FNV-1a, used to tell whether an asset changed since something was derived from it.
+std::uint64_t contentHash(std::span<const unsigned char> data);
+} // namespace Util
@@ -1,30 +1,125 @@
 #include "lazytexture.h"
 
 #include "pixmap.h"
+#include "paintercapture.h"
+#include "pixeluploadring.h"
+#include "system.h"
+#include "textureuploader.h"
+
+#include <algorithm>
+
+namespace
+{
+std::uint64_t s_sequence = 0;
+}
 
 LazyTexture::LazyTexture(const Pixmap *pixmap)
     : m_pixmap(pixmap)
     , m_texture(pixmap->width, pixmap->height, pixmap->pixelType)
-    , m_dirty(true)
 {
 }
 
-void LazyTexture::markDirty()
+LazyTexture::~LazyTexture()
 {
-    m_dirty = true;
+    if (!m_dirtyRegions.empty())
+        System::instance()->textureUploader()->cancel(this);
 }
 
-void LazyTexture::bind() const
+void LazyTexture::markDirty(UploadPriority priority)
+{
+    m_dirtyRegions.clear();
+    markDirty(RectI{{0, 0}, {m_pixmap->width, m_pixmap->height}}, priority);
+}
+
+void LazyTexture::markDirty(const RectI &rect, UploadPriority priority)
 {
-    if (m_dirty)
+    DirtyRegion merged{rect.intersected(RectI{{0, 0}, {m_pixmap->width, m_pixmap->height}}), priority, s_sequence++};
+    if (merged.rect.width() == 0 || merged.rect.height() == 0)
+        return;
+
+    // the union of two rects may overlap rects that neither did, so keep going until nothing overlaps
+    for (auto it = m_dirtyRegions.begin(); it != m_dirtyRegions.end();)
     {
-        m_texture.setData(m_pixmap->pixels.data());
-        m_dirty = false;
+        if (it->rect.intersects(merged.rect))
+        {
+            merged.rect |= it->rect;
+            merged.priority = std::max(merged.priority, it->priority);
+            merged.sequence = std::min(merged.sequence, it->sequence);
+            *it = m_dirtyRegions.back();
+            m_dirtyRegions.pop_back();
+            it = m_dirtyRegions.begin();
+        }
+        else
+        {
+            ++it;
+        }
     }
+    if (m_dirtyRegions.empty())
+        System::instance()->textureUploader()->schedule(this);
+    m_dirtyRegions.push_back(merged);
+}
+
+void LazyTexture::bind() const
+{
+    // whatever is still pending is needed now, so it goes ahead of speculative uploads next frame
+    for (auto &region : m_dirtyRegions)
+        region.priority = UploadPriority::High;
+    m_lastBoundFrame = System::instance()->frameNumber();
     m_texture.bind();
 }
 
+void LazyTexture::prepareSampling(const RectF &texRect) const
+{
+    if (m_dirtyRegions.empty())
+        return;
+    const auto rect = RectI{glm::ivec2(glm::floor(texRect.min)), glm::ivec2(glm::ceil(texRect.max))};
+    if (std::none_of(m_dirtyRegions.begin(), m_dirtyRegions.end(),
+                     [&rect](const DirtyRegion &region) { return region.rect.intersects(rect); }))
+        return;
+    // const like bind(): the texture mirrors the same pixmap before and after
+    System::instance()->textureUploader()->flush(const_cast<LazyTexture *>(this), rect);
+}
+
+std::size_t LazyTexture::upload(const RectI &rect, gl::PixelUploadRing *ring)
+{
+    auto it = std::find_if(m_dirtyRegions.begin(), m_dirtyRegions.end(),
+                           [&rect](const DirtyRegion &region) { return region.rect == rect; });
+    if (it == m_dirtyRegions.end())
+        return 0;
+    m_dirtyRegions.erase(it);
+
+    const auto pixelSize = pixelSizeInBytes(m_pixmap->pixelType);
+    const auto *data = m_pixmap->pixels.data() + (rect.min.y * m_pixmap->width + rect.min.x) * pixelSize;
+    if (!ring || !ring->upload(m_texture, rect, data, m_pixmap->width, pixelSize))
+        m_texture.setData(rect, data, m_pixmap->width);
+    if (auto *capture = System::instance()->painterCapture())
+        capture->textureUpload(this, *m_pixmap, rect);
+
+    const auto bytes = rect.width() * rect.height() * pixelSize;
+    auto &stats = System::instance()->frameStats();
+    ++stats.textureUploads;
+    stats.bytesUploaded += bytes;
+    return bytes;
+}
+
 const Pixmap *LazyTexture::pixmap() const
 {
     return m_pixmap;
 }
+
+int LazyTexture::width() const
+{
+    return m_texture.width();
+}
+
+int LazyTexture::height() const
+{
+    return m_texture.height();
+}
+
+void LazyTexture::resize()
+{
+    const auto uploaded = RectI{{0, 0}, {m_texture.width(), m_texture.height()}};
+    m_texture.resize(m_pixmap->width, m_pixmap->height);
+    markDirty(uploaded, UploadPriority::High);
+}
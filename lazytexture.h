@@ -2,22 +2,62 @@
 
 #include "abstracttexture.h"
 #include "texture.h"
+#include "util.h"
+
+#include <cstdint>
+#include <vector>
 
 struct Pixmap;
 
+namespace gl
+{
+class PixelUploadRing;
+}
+
+enum class UploadPriority
+{
+    Low,  // speculative, e.g. prewarmed glyphs
+    High, // needed for drawing
+};
+
+// Texture that mirrors a pixmap. Regions marked dirty are uploaded by the TextureUploader at the start of a later
+// frame, or right away, outside the budget, if a sprite samples them before that. Regions that were never uploaded
+// have undefined contents on the GPU.
 class LazyTexture : public AbstractTexture
 {
 public:
     explicit LazyTexture(const Pixmap *pixmap);
+    ~LazyTexture() override;
 
-    void markDirty();
+    void markDirty(UploadPriority priority = UploadPriority::High);
+    void markDirty(const RectI &rect, UploadPriority priority = UploadPriority::High);
 
-    void bind() const;
+    void bind() const override;
+    void prepareSampling(const RectF &texRect) const override;
 
     const Pixmap *pixmap() const;
 
+    int width() const override;
+    int height() const override;
+
+    // Follows the pixmap after it grew. What was uploaded before is uploaded again.
+    void resize();
+
+    int lastBoundFrame() const { return m_lastBoundFrame; } // System::frameNumber()
+
+    struct DirtyRegion
+    {
+        RectI rect;
+        UploadPriority priority;
+        std::uint64_t sequence; // order in which regions were marked dirty
+    };
+    const std::vector<DirtyRegion> &dirtyRegions() const { return m_dirtyRegions; }
+    // Uploads one of the dirty regions, staged through `ring` if there's one. Returns the number of bytes.
+    std::size_t upload(const RectI &rect, gl::PixelUploadRing *ring = nullptr);
+
 private:
     const Pixmap *m_pixmap;
     gl::Texture m_texture;
-    mutable bool m_dirty;
+    mutable std::vector<DirtyRegion> m_dirtyRegions; // don't overlap
+    mutable int m_lastBoundFrame = -1;
 };
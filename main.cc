@@ -1,18 +1,51 @@
 #include "log.h"
+#include "fontcache.h"
 #include "game.h"
 #include "system.h"
+#include "textureuploader.h"
 #include "mouseevent.h"
+#include "trace.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
 
+#include <algorithm>
+#include <cstdlib>
 #include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace
+{
+std::string s_tracePath;
+int s_traceDumps = 0;
+
+// F12 writes what's in the trace buffers now, to TRACE_FILE with a number inserted before the extension, so that a
+// stutter can be caught without quitting
+void dumpTrace()
+{
+    auto path = s_tracePath;
+    const auto dot = path.rfind('.');
+    const auto slash = path.find_last_of("/\\");
+    const auto insertAt = dot != std::string::npos && (slash == std::string::npos || dot > slash) ? dot : path.size();
+    path.insert(insertAt, "-" + std::to_string(++s_traceDumps));
+    trace::writeJson(path);
+}
+} // namespace
 
 int main()
 {
     constexpr auto Width = 800;
     constexpr auto Height = 600;
 
+    if (const char *tracePath = std::getenv("TRACE_FILE"))
+    {
+        s_tracePath = tracePath;
+        trace::setEnabled(true);
+        trace::setDumpOnExit(tracePath);
+    }
+
     glfwInit();
     glfwSetErrorCallback(
         [](int error, const char *description) { panic("GLFW error %08x: %s\n", error, description); });
@@ -32,6 +65,45 @@ int main()
 
         {
             System::initialize();
+            if (const char *capturePath = std::getenv("CAPTURE_FILE"))
+            {
+                const char *frames = std::getenv("CAPTURE_FRAMES");
+                System::instance()->startCapture(capturePath, frames ? std::atoi(frames) : -1);
+            }
+            if (const char *uploadBudget = std::getenv("UPLOAD_BUDGET"))
+                System::instance()->textureUploader()->setByteBudget(std::strtoul(uploadBudget, nullptr, 10));
+            if (const char *sdfText = std::getenv("SDF_TEXT"))
+                System::instance()->fontCache()->setSdfGlyphs(std::atoi(sdfText) != 0);
+            if (const char *rasterizer = std::getenv("GLYPH_RASTERIZER"))
+            {
+                System::instance()->fontCache()->setGlyphRasterizer(std::string_view(rasterizer) == "accumulation"
+                                                                         ? miniui::Font::Rasterizer::Accumulation
+                                                                         : miniui::Font::Rasterizer::Stb);
+            }
+            if (const char *subpixelText = std::getenv("SUBPIXEL_TEXT"))
+                System::instance()->fontCache()->setSubpixelGlyphs(std::atoi(subpixelText) != 0);
+            // comma-separated font names, e.g. FONT_FALLBACKS=NotoSansCJK_Regular,NotoEmoji_Regular
+            if (const char *fallbacks = std::getenv("FONT_FALLBACKS"))
+            {
+                std::vector<std::string> names;
+                for (std::string_view rest = fallbacks; !rest.empty();)
+                {
+                    const auto comma = std::min(rest.find(','), rest.size());
+                    if (comma > 0)
+                        names.emplace_back(rest.substr(0, comma));
+                    rest.remove_prefix(std::min(comma + 1, rest.size()));
+                }
+                System::instance()->fontCache()->setFallbacks("OpenSans_Regular", std::move(names));
+            }
+            // on unless ASYNC_GLYPHS=0, the headless tools rasterize synchronously to stay deterministic
+            const char *asyncGlyphs = std::getenv("ASYNC_GLYPHS");
+            System::instance()->fontCache()->setAsyncGlyphs(!asyncGlyphs || std::atoi(asyncGlyphs) != 0);
+
+            // ATLAS_CACHE= (empty) disables the cache
+            const char *atlasCacheEnv = std::getenv("ATLAS_CACHE");
+            const std::string atlasCachePath = atlasCacheEnv ? atlasCacheEnv : "atlas.cache";
+            if (!atlasCachePath.empty())
+                System::instance()->loadAtlasCache(atlasCachePath);
 
             auto game = std::make_unique<Game>();
 
@@ -70,17 +142,27 @@ int main()
                 auto *game = reinterpret_cast<Game *>(glfwGetWindowUserPointer(window));
                 game->onMouseMove({x, y});
             });
+            glfwSetKeyCallback(window.get(), [](GLFWwindow *, int key, int, int action, int) {
+                if (key == GLFW_KEY_F12 && action == GLFW_PRESS && !s_tracePath.empty())
+                    dumpTrace();
+            });
 
             game->resize(Width, Height);
 
             while (!glfwWindowShouldClose(window.get()))
             {
+                System::instance()->frameStats().reset();
                 game->update(1.0f / 60.0f);
                 game->render();
-                glfwSwapBuffers(window.get());
+                {
+                    TRACE_ZONE("glfwSwapBuffers");
+                    glfwSwapBuffers(window.get());
+                }
                 glfwPollEvents();
             }
 
+            if (!atlasCachePath.empty())
+                System::instance()->saveAtlasCache(atlasCachePath);
             System::shutdown();
         }
     }
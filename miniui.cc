@@ -17,8 +17,8 @@ namespace
 {
 Font *defaultFont()
 {
-    static Font *font = System::instance()->fontCache()->font("OpenSans_Regular", 40);
-    return font;
+    // not cached: the font cache goes away with the System instance
+    return System::instance()->fontCache()->font("OpenSans_Regular", 40);
 }
 } // namespace
 
@@ -113,7 +113,7 @@ Label::Label(std::u32string_view text)
 
 Label::Label(Font *font, std::u32string_view text)
     : m_font(font)
-    , m_text(text)
+    , m_run(font, text)
 {
     updateSize();
 }
@@ -121,7 +121,7 @@ Label::Label(Font *font, std::u32string_view text)
 bool Label::mouseEvent(const MouseEvent &event)
 {
     if (event.type == MouseEvent::Type::Click)
-        log("**** clicked label %s\n", std::string(m_text.begin(), m_text.end()).c_str());
+        log("**** clicked label %s\n", std::string(text().begin(), text().end()).c_str());
     return Item::mouseEvent(event);
 }
 
@@ -130,14 +130,15 @@ void Label::setFont(Font *font)
     if (font == m_font)
         return;
     m_font = font;
+    m_run = TextRun(m_font, m_run.text());
     updateSize();
 }
 
 void Label::setText(std::u32string_view text)
 {
-    if (text == m_text)
+    if (text == m_run.text())
         return;
-    m_text = text;
+    m_run = TextRun(m_font, text);
     updateSize();
 }
 
@@ -168,7 +169,7 @@ void Label::setFixedHeight(float height)
 void Label::updateSize()
 {
     m_contentHeight = m_font->pixelHeight();
-    m_contentWidth = m_font->textWidth(m_text);
+    m_contentWidth = m_run.width();
     const float height = [this] {
         if (m_fixedHeight > 0)
             return m_fixedHeight;
@@ -229,8 +230,7 @@ void Label::renderContents(Painter *painter, const glm::vec2 &pos, int depth)
         }
     }();
     const auto textPos = pos + glm::vec2(m_margins.left, m_margins.top) + glm::vec2(xOffset, yOffset);
-    painter->setFont(m_font);
-    painter->drawText(m_text, textPos, color, depth + 1);
+    painter->drawTextRun(m_run, textPos, color, depth + 1);
 
     if (clipped)
         painter->setClipRect(prevClipRect);
@@ -399,10 +399,7 @@ bool Container::mouseEvent(const MouseEvent &event)
 
 void Container::addItem(std::unique_ptr<Item> item)
 {
-    auto resizedConnection = item->resizedSignal.connect([this](Size size) {
-        log("child resized: %f %f\n", size.width, size.height);
-        updateLayout();
-    });
+    auto resizedConnection = item->resizedSignal.connect([this](Size) { updateLayout(); });
     m_layoutItems.emplace_back(new LayoutItem{{}, std::move(item)});
     m_childResizedConnections.push_back(std::move(resizedConnection));
     updateLayout();
@@ -732,7 +729,7 @@ void MultiLineText::updateSize()
     breakTextLines();
     m_contentWidth = 0.0f;
     for (const auto &line : m_lines)
-        m_contentWidth = std::max(line.width, m_contentWidth);
+        m_contentWidth = std::max(line.width(), m_contentWidth);
     m_contentHeight = m_lines.size() * m_font->pixelHeight();
     const float height = [this] {
         if (m_fixedHeight > 0)
@@ -776,8 +773,7 @@ void MultiLineText::renderContents(Painter *painter, const glm::vec2 &pos, int d
         }
     }();
     auto textPos = pos + glm::vec2(m_margins.left, m_margins.top) + glm::vec2(0.0f, yOffset);
-    painter->setFont(m_font);
-    for (const auto &line : m_lines)
+    for (auto &line : m_lines)
     {
         const auto offset = [this, &line, availableWidth] {
             const auto horizAlignment = alignment & (Alignment::Left | Alignment::HCenter | Alignment::Right);
@@ -787,12 +783,12 @@ void MultiLineText::renderContents(Painter *painter, const glm::vec2 &pos, int d
             default:
                 return 0.0f;
             case Alignment::HCenter:
-                return 0.5f * (availableWidth - line.width);
+                return 0.5f * (availableWidth - line.width());
             case Alignment::Right:
-                return availableWidth - line.width;
+                return availableWidth - line.width();
             }
         }();
-        painter->drawText(line.text, textPos + glm::vec2(offset, 0), color, depth + 1);
+        painter->drawTextRun(line, textPos + glm::vec2(offset, 0), color, depth + 1);
         textPos.y += m_font->pixelHeight();
     }
 
@@ -820,14 +816,17 @@ void MultiLineText::breakTextLines()
 
     const auto spaceWidth = m_font->glyph(' ')->advanceWidth;
 
-    const auto makeLine = [](Position start, Position end) {
-        return TextLine{std::u32string_view(start.it, end.it), end.x - start.x};
+    const auto makeLine = [this](Position start, Position end) {
+        return TextRun(m_font, std::u32string_view(start.it, end.it));
     };
 
     float lineWidth = 0.0f;
     for (auto it = m_text.begin(); it != m_text.end(); ++it)
     {
         const auto ch = *it;
+        const auto *glyph = m_font->glyph(ch);
+        if (it != m_text.begin())
+            lineWidth += m_font->kerning(*(it - 1), ch);
         if (ch == ' ')
         {
             if (lineWidth - rowStart.x > availableWidth)
@@ -849,7 +848,7 @@ void MultiLineText::breakTextLines()
                 lastBreak = {it, lineWidth};
             }
         }
-        lineWidth += m_font->glyph(ch)->advanceWidth;
+        lineWidth += glyph->advanceWidth;
     }
     if (rowStart.it != m_text.end())
     {
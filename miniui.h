@@ -2,6 +2,7 @@
 
 #include "textureatlas.h"
 #include "font.h"
+#include "textrun.h"
 #include "signal.h"
 #include "mouseevent.h"
 #include "tweening.h"
@@ -140,7 +141,7 @@ public:
     Font *font() const { return m_font; }
 
     void setText(std::u32string_view text);
-    const std::u32string &text() const { return m_text; }
+    const std::u32string &text() const { return m_run.text(); }
 
     void setMargins(Margins margins);
     Margins margins() const { return m_margins; }
@@ -161,7 +162,7 @@ private:
     void updateSize();
 
     Font *m_font;
-    std::u32string m_text;
+    TextRun m_run;
     Margins m_margins;
     float m_contentWidth = 0;
     float m_contentHeight = 0;
@@ -330,12 +331,7 @@ private:
     float m_fixedHeight = -1;    // ignored if < 0
     float m_contentWidth = 0.0f;
     float m_contentHeight = 0.0f;
-    struct TextLine
-    {
-        std::u32string_view text;
-        float width;
-    };
-    std::vector<TextLine> m_lines;
+    std::vector<TextRun> m_lines;
 };
 
 class Switch : public Item
@@ -0,0 +1,217 @@
+#include "outlinerasterizer.h"
+
+#include <stb_truetype.h>
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace
+{
+// curves are split into 1 + (Tolerance * deviation^2)^(1/4) lines, larger is finer
+constexpr auto Tolerance = 3.0f;
+} // namespace
+
+void OutlineRasterizer::reset(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    m_accumulation.assign(static_cast<std::size_t>(width) * height + 4, 0.0f);
+}
+
+void OutlineRasterizer::drawLine(const glm::vec2 &from, const glm::vec2 &to)
+{
+    if (from.y == to.y)
+        return;
+    const auto direction = from.y < to.y ? 1.0f : -1.0f;
+    const auto &p0 = from.y < to.y ? from : to;
+    const auto &p1 = from.y < to.y ? to : from;
+
+    const auto dxdy = (p1.x - p0.x) / (p1.y - p0.y);
+    auto x = p0.x;
+    if (p0.y < 0.0f)
+        x -= p0.y * dxdy;
+    const auto yBegin = std::max(0, static_cast<int>(p0.y));
+    const auto yEnd = std::min(m_height, static_cast<int>(std::ceil(p1.y)));
+    for (int y = yBegin; y < yEnd; ++y)
+    {
+        // the segment's stretch within this row spans the cells [x0i, x1i]
+        const auto dy = std::min(static_cast<float>(y + 1), p1.y) - std::max(static_cast<float>(y), p0.y);
+        const auto xNext = x + dxdy * dy;
+        const auto d = dy * direction;
+        const auto x0 = std::min(x, xNext);
+        const auto x1 = std::max(x, xNext);
+        const auto x0Floor = std::floor(x0);
+        const auto x0i = static_cast<int>(x0Floor);
+        const auto x1Ceil = std::ceil(x1);
+        const auto x1i = static_cast<int>(x1Ceil);
+        const auto lineStart = static_cast<std::ptrdiff_t>(y) * m_width;
+        if (lineStart + x0i < 0)
+        {
+            x = xNext;
+            continue;
+        }
+        auto *cells = m_accumulation.data() + lineStart + x0i;
+        if (x1i <= x0i + 1)
+        {
+            const auto xm = 0.5f * (x + xNext) - x0Floor;
+            cells[0] += d - d * xm;
+            cells[1] += d * xm;
+        }
+        else
+        {
+            const auto s = 1.0f / (x1 - x0);
+            const auto x0f = x0 - x0Floor;
+            const auto a0 = 0.5f * s * (1.0f - x0f) * (1.0f - x0f);
+            const auto x1f = x1 - x1Ceil + 1.0f;
+            const auto am = 0.5f * s * x1f * x1f;
+            cells[0] += d * a0;
+            if (x1i == x0i + 2)
+            {
+                cells[1] += d * (1.0f - a0 - am);
+            }
+            else
+            {
+                const auto a1 = s * (1.5f - x0f);
+                cells[1] += d * (a1 - a0);
+                for (int xi = 2; xi < x1i - x0i - 1; ++xi)
+                    cells[xi] += d * s;
+                const auto a2 = a1 + (x1i - x0i - 3) * s;
+                cells[x1i - x0i - 1] += d * (1.0f - a2 - am);
+            }
+            cells[x1i - x0i] += d * am;
+        }
+        x = xNext;
+    }
+}
+
+void OutlineRasterizer::drawQuad(const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2)
+{
+    const auto deviation = p0 - 2.0f * p1 + p2;
+    const auto deviationSquared = glm::dot(deviation, deviation);
+    if (deviationSquared < 0.333f)
+    {
+        drawLine(p0, p2);
+        return;
+    }
+    const auto segments = 1 + static_cast<int>(std::floor(std::sqrt(std::sqrt(Tolerance * deviationSquared))));
+    auto p = p0;
+    for (int i = 1; i < segments; ++i)
+    {
+        const auto t = static_cast<float>(i) / segments;
+        const auto next = glm::mix(glm::mix(p0, p1, t), glm::mix(p1, p2, t), t);
+        drawLine(p, next);
+        p = next;
+    }
+    drawLine(p, p2);
+}
+
+void OutlineRasterizer::drawCubic(const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &p3)
+{
+    const auto deviation = glm::max(glm::abs(p0 - 2.0f * p1 + p2), glm::abs(p1 - 2.0f * p2 + p3));
+    const auto deviationSquared = glm::dot(deviation, deviation);
+    if (deviationSquared < 0.333f)
+    {
+        drawLine(p0, p3);
+        return;
+    }
+    const auto segments = 1 + static_cast<int>(std::floor(std::sqrt(std::sqrt(Tolerance * deviationSquared))));
+    auto p = p0;
+    for (int i = 1; i < segments; ++i)
+    {
+        const auto t = static_cast<float>(i) / segments;
+        const auto q0 = glm::mix(p0, p1, t);
+        const auto q1 = glm::mix(p1, p2, t);
+        const auto q2 = glm::mix(p2, p3, t);
+        const auto next = glm::mix(glm::mix(q0, q1, t), glm::mix(q1, q2, t), t);
+        drawLine(p, next);
+        p = next;
+    }
+    drawLine(p, p3);
+}
+
+void OutlineRasterizer::accumulate(unsigned char *pixels, int stride) const
+{
+    // the running sum carries over from one row to the next, segments ending on the right edge spill into the
+    // first cell of the next row
+    float sum = 0.0f;
+    for (int y = 0; y < m_height; ++y)
+    {
+        const auto *cells = m_accumulation.data() + static_cast<std::size_t>(y) * m_width;
+        auto *row = pixels + static_cast<std::ptrdiff_t>(y) * stride;
+        int x = 0;
+#if defined(__SSE2__)
+        // prefix sum of four cells at a time: two shifted adds within the register, plus the running total
+        auto offset = _mm_set1_ps(sum);
+        const auto signMask = _mm_set1_ps(-0.0f);
+        const auto one = _mm_set1_ps(1.0f);
+        const auto scale = _mm_set1_ps(255.0f);
+        for (; x + 4 <= m_width; x += 4)
+        {
+            auto v = _mm_loadu_ps(cells + x);
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 4)));
+            v = _mm_add_ps(v, _mm_castsi128_ps(_mm_slli_si128(_mm_castps_si128(v), 8)));
+            v = _mm_add_ps(v, offset);
+            const auto coverage = _mm_mul_ps(_mm_min_ps(_mm_andnot_ps(signMask, v), one), scale);
+            auto values = _mm_cvtps_epi32(coverage);
+            values = _mm_packs_epi32(values, values);
+            values = _mm_packus_epi16(values, values);
+            const auto packed = _mm_cvtsi128_si32(values);
+            std::copy_n(reinterpret_cast<const unsigned char *>(&packed), 4, row + x);
+            offset = _mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3));
+        }
+        sum = _mm_cvtss_f32(offset);
+#endif
+        for (; x < m_width; ++x)
+        {
+            sum += cells[x];
+            row[x] = static_cast<unsigned char>(std::lround(std::min(std::abs(sum), 1.0f) * 255.0f));
+        }
+    }
+}
+
+void OutlineRasterizer::rasterizeCodepoint(const stbtt_fontinfo *info, int codepoint, float scale, float shiftX,
+                                           unsigned char *pixels, int width, int height, int stride)
+{
+    reset(width, height);
+
+    int ix0, iy0, ix1, iy1;
+    stbtt_GetCodepointBitmapBoxSubpixel(info, codepoint, scale, scale, shiftX, 0.0f, &ix0, &iy0, &ix1, &iy1);
+    // font units are y up, the bitmap is y down
+    const auto toBitmap = [scale, shiftX, ix0, iy0](int x, int y) {
+        return glm::vec2(x * scale + shiftX - ix0, -y * scale - iy0);
+    };
+
+    stbtt_vertex *vertices = nullptr;
+    const auto vertexCount = stbtt_GetCodepointShape(info, codepoint, &vertices);
+    glm::vec2 contourStart(0.0f), p(0.0f);
+    for (int i = 0; i < vertexCount; ++i)
+    {
+        const auto &vertex = vertices[i];
+        const auto next = toBitmap(vertex.x, vertex.y);
+        switch (vertex.type)
+        {
+        case STBTT_vmove:
+            drawLine(p, contourStart); // close the previous contour, if it isn't already
+            contourStart = next;
+            break;
+        case STBTT_vline:
+            drawLine(p, next);
+            break;
+        case STBTT_vcurve:
+            drawQuad(p, toBitmap(vertex.cx, vertex.cy), next);
+            break;
+        case STBTT_vcubic:
+            drawCubic(p, toBitmap(vertex.cx, vertex.cy), toBitmap(vertex.cx1, vertex.cy1), next);
+            break;
+        }
+        p = next;
+    }
+    drawLine(p, contourStart);
+    stbtt_FreeShape(info, vertices);
+
+    accumulate(pixels, stride);
+}
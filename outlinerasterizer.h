@@ -0,0 +1,33 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+struct stbtt_fontinfo;
+
+// Coverage rasterizer for glyph outlines in the style of font-rs. Every segment adds its signed area to the cells
+// it crosses in an accumulation buffer, and a single running sum over the buffer then yields the coverage of each
+// pixel. Quadratic curves are flattened into lines first. Outlines must be closed and lie within the bitmap.
+class OutlineRasterizer
+{
+public:
+    void reset(int width, int height);
+
+    void drawLine(const glm::vec2 &p0, const glm::vec2 &p1);
+    void drawQuad(const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2);
+    void drawCubic(const glm::vec2 &p0, const glm::vec2 &p1, const glm::vec2 &p2, const glm::vec2 &p3);
+
+    // Writes 8-bit coverage, `stride` bytes per row.
+    void accumulate(unsigned char *pixels, int stride) const;
+
+    // Same output as stbtt_MakeCodepointBitmapSubpixel: the outline at `scale`, shifted right by `shiftX` pixels,
+    // with the top left of its bitmap box (see stbtt_GetCodepointBitmapBoxSubpixel) at the origin.
+    void rasterizeCodepoint(const stbtt_fontinfo *info, int codepoint, float scale, float shiftX,
+                            unsigned char *pixels, int width, int height, int stride);
+
+private:
+    int m_width = 0;
+    int m_height = 0;
+    std::vector<float> m_accumulation; // row by row, with room for segments touching the right edge of the last row
+};
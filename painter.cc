@@ -3,6 +3,9 @@
 #include "spritebatcher.h"
 #include "font.h"
 #include "log.h"
+#include "paintercapture.h"
+#include "system.h"
+#include "textrun.h"
 
 #include <GL/glew.h>
 
@@ -34,6 +37,11 @@ void Painter::updateTransformMatrix()
 
 void Painter::begin()
 {
+    m_capture = System::instance()->painterCapture();
+    if (m_capture)
+        m_capture->beginFrame(m_windowWidth, m_windowHeight);
+    System::instance()->beginFrame();
+    m_frame = System::instance()->frameNumber();
     m_font = nullptr;
     setClipRect({{0, 0}, {m_windowWidth, m_windowHeight}});
     m_spriteBatcher->begin();
@@ -42,6 +50,8 @@ void Painter::begin()
 void Painter::end()
 {
     m_spriteBatcher->flush();
+    if (m_capture)
+        m_capture->endFrame();
 }
 
 void Painter::setFont(Font *font)
@@ -58,6 +68,9 @@ void Painter::setClipRect(const RectF &rect)
     const auto w = static_cast<GLint>(rect.width());
     const auto h = static_cast<GLint>(rect.height());
     glScissor(x, m_windowHeight - (y + h), w, h); // XXX shouldn't be here
+    // recorded after the flush so that uploads done by the flush come first in the capture
+    if (m_capture)
+        m_capture->setClipRect(rect);
 }
 
 void Painter::drawRect(const RectF &rect, const glm::vec4 &color, int depth)
@@ -66,6 +79,8 @@ void Painter::drawRect(const RectF &rect, const glm::vec4 &color, int depth)
     {
         m_spriteBatcher->setBatchProgram(ShaderManager::Flat);
         m_spriteBatcher->addSprite(rect, color, depth);
+        if (m_capture)
+            m_capture->drawRect(rect, color, depth);
     }
 }
 
@@ -75,6 +90,8 @@ void Painter::drawPixmap(const PackedPixmap &pixmap, const RectF &rect, const gl
     {
         m_spriteBatcher->setBatchProgram(ShaderManager::Decal);
         m_spriteBatcher->addSprite(pixmap, rect, color, depth);
+        if (m_capture)
+            m_capture->drawPixmap(pixmap, rect, color, depth);
     }
 }
 
@@ -93,7 +110,10 @@ void Painter::drawPixmap(const PackedPixmap &pixmap, const RectF &rect, const Re
         };
         const auto spriteRect = rect.intersected(clipRect);
         const auto texCoord = RectF{texPos(spriteRect.min), texPos(spriteRect.max)};
-        m_spriteBatcher->addSprite(pixmap.texture, spriteRect, texCoord, color, depth);
+        m_spriteBatcher->addSprite(pixmap.texture, spriteRect, texCoord, color, depth, pixmap.channel);
+        if (m_capture)
+            m_capture->drawPixmap({pixmap.width, pixmap.height, texCoord, pixmap.texture, pixmap.channel}, spriteRect,
+                                  color, depth);
     }
 }
 
@@ -105,20 +125,105 @@ void Painter::drawText(std::u32string_view text, const glm::vec2 &pos, const glm
         return;
     }
 
-    m_spriteBatcher->setBatchProgram(ShaderManager::Text);
-
     auto basePos = glm::vec2(pos.x, pos.y + m_font->ascent());
+    const bool subpixel = m_font->subpixelPositioning();
+    char32_t previous = 0;
     for (auto ch : text)
     {
-        if (const auto *g = m_font->glyph(ch); g)
+        const auto *g = m_font->glyph(ch);
+        if (!g)
+            continue;
+        if (previous)
+            basePos.x += m_font->kerning(previous, ch);
+        previous = ch;
+        g->lastUsedFrame = m_frame;
+        const auto advanceWidth = g->advanceWidth;
+
+        auto origin = basePos;
+        if (subpixel)
+        {
+            const auto [x, phase] = Font::subpixelPosition(basePos.x);
+            origin.x = x;
+            if (phase != 0)
+            {
+                g = m_font->glyph(ch, phase);
+                if (g)
+                    g->lastUsedFrame = m_frame;
+            }
+        }
+        if (g && !g->pending)
         {
-            const auto topLeft = basePos + glm::vec2(g->boundingBox.min);
+            const auto topLeft = origin + glm::vec2(g->boundingBox.min);
             const auto bottomRight = topLeft + glm::vec2(g->boundingBox.max - g->boundingBox.min);
-            const auto rect = RectF{topLeft, bottomRight};
-            if (m_clipRect.intersects(rect))
-                m_spriteBatcher->addSprite(g->pixmap, rect, color, depth);
-            basePos.x += g->advanceWidth;
+            if (m_font->isSdf())
+                drawSdfGlyph(g->pixmap, RectF{topLeft, bottomRight}, color, depth);
+            else
+                drawGlyph(g->pixmap, RectF{topLeft, bottomRight}, color, depth);
+        }
+        basePos.x += advanceWidth;
+    }
+}
+
+void Painter::drawTextRun(TextRun &run, const glm::vec2 &pos, const glm::vec4 &color, int depth)
+{
+    auto *font = run.font();
+    if (!font)
+        return;
+    if (!run.isValid())
+        run.reshape();
+
+    const auto basePos = glm::vec2(pos.x, pos.y + font->ascent());
+    const bool sdf = font->isSdf();
+    const bool subpixel = font->subpixelPositioning();
+    for (const auto &runGlyph : run.glyphs())
+    {
+        // the run's own glyph keeps the run valid even when only shifted variants get drawn
+        const auto *g = &font->glyphAt(runGlyph.slot);
+        g->lastUsedFrame = m_frame;
+
+        auto origin = basePos + glm::vec2(runGlyph.x, 0.0f);
+        if (subpixel)
+        {
+            const auto [x, phase] = Font::subpixelPosition(origin.x);
+            origin.x = x;
+            if (phase != 0)
+            {
+                g = font->glyph(runGlyph.codepoint, phase);
+                if (!g)
+                    continue;
+                g->lastUsedFrame = m_frame;
+            }
         }
+        if (g->pending)
+            continue;
+        const auto topLeft = origin + glm::vec2(g->boundingBox.min);
+        const auto bottomRight = topLeft + glm::vec2(g->boundingBox.max - g->boundingBox.min);
+        if (sdf)
+            drawSdfGlyph(g->pixmap, RectF{topLeft, bottomRight}, color, depth);
+        else
+            drawGlyph(g->pixmap, RectF{topLeft, bottomRight}, color, depth);
+    }
+}
+
+void Painter::drawGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
+{
+    if (m_clipRect.intersects(rect))
+    {
+        m_spriteBatcher->setBatchProgram(ShaderManager::Text);
+        m_spriteBatcher->addSprite(pixmap, rect, color, depth);
+        if (m_capture)
+            m_capture->drawGlyph(pixmap, rect, color, depth);
+    }
+}
+
+void Painter::drawSdfGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
+{
+    if (m_clipRect.intersects(rect))
+    {
+        m_spriteBatcher->setBatchProgram(ShaderManager::SdfText);
+        m_spriteBatcher->addSprite(pixmap, rect, color, depth);
+        if (m_capture)
+            m_capture->drawSdfGlyph(pixmap, rect, color, depth);
     }
 }
 
@@ -131,6 +236,8 @@ void Painter::drawCircle(const glm::vec2 &center, float radius, const glm::vec4
     {
         m_spriteBatcher->setBatchProgram(ShaderManager::Circle);
         m_spriteBatcher->addSprite(nullptr, rect, {{0, 0}, {1, 1}}, color, depth);
+        if (m_capture)
+            m_capture->drawCircle(center, radius, color, depth);
     }
 }
 
@@ -138,6 +245,8 @@ void Painter::drawCapsule(const RectF &rect, const glm::vec4 &color, int depth)
 {
     if (!m_clipRect.intersects(rect))
         return;
+    if (m_capture)
+        m_capture->drawCapsule(rect, color, depth);
     m_spriteBatcher->setBatchProgram(ShaderManager::Circle);
     const auto width = rect.width();
     const auto height = rect.height();
@@ -185,6 +294,8 @@ void Painter::drawRoundedRect(const RectF &rect, float cornerRadius, const glm::
 {
     if (!m_clipRect.intersects(rect))
         return;
+    if (m_capture)
+        m_capture->drawRoundedRect(rect, cornerRadius, color, depth);
     m_spriteBatcher->setBatchProgram(ShaderManager::Circle);
     const auto width = rect.width();
     const auto height = rect.height();
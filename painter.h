@@ -21,6 +21,8 @@ class SpriteBatcher;
 namespace miniui
 {
 class Font;
+class PainterCapture;
+class TextRun;
 
 class Painter : private NonCopyable
 {
@@ -43,6 +45,10 @@ public:
     void drawPixmap(const PackedPixmap &pixmap, const RectF &rect, const RectF &clipRect, const glm::vec4 &color,
                     int depth);
     void drawText(std::u32string_view text, const glm::vec2 &pos, const glm::vec4 &color, int depth);
+    // Doesn't need setFont(), the run has its own.
+    void drawTextRun(TextRun &run, const glm::vec2 &pos, const glm::vec4 &color, int depth);
+    void drawGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
+    void drawSdfGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
     void drawCircle(const glm::vec2 &center, float radius, const glm::vec4 &color, int depth);
     void drawCapsule(const RectF &rect, const glm::vec4 &color, int depth);
     void drawRoundedRect(const RectF &rect, float cornerRadius, const glm::vec4 &color, int depth);
@@ -55,6 +61,8 @@ private:
     int m_windowHeight = 0;
     std::unique_ptr<gl::SpriteBatcher> m_spriteBatcher;
     Font *m_font = nullptr;
+    PainterCapture *m_capture = nullptr;
+    int m_frame = 0;
     RectF m_clipRect;
     bool m_clippingEnabled = false;
 };
@@ -0,0 +1,188 @@
+#include "paintercapture.h"
+
+#include "lazytexture.h"
+#include "log.h"
+#include "pixmap.h"
+#include "textureatlas.h"
+
+namespace miniui
+{
+
+PainterCapture::PainterCapture(const std::string &path, int maxFrames)
+    : m_file(std::fopen(path.c_str(), "wb"))
+    , m_maxFrames(maxFrames)
+{
+    if (!m_file)
+    {
+        log("Failed to open capture file %s\n", path.c_str());
+        return;
+    }
+    write(Magic);
+    write(Version);
+    log("Capturing painter commands to %s\n", path.c_str());
+}
+
+PainterCapture::~PainterCapture()
+{
+    if (m_file)
+    {
+        std::fclose(m_file);
+        log("Captured %d frames\n", m_frameCount);
+    }
+}
+
+void PainterCapture::beginFrame(int windowWidth, int windowHeight)
+{
+    if (!m_file || (m_maxFrames >= 0 && m_frameCount >= m_maxFrames))
+        return;
+    m_inFrame = true;
+    write(Command::FrameBegin);
+    write<std::int32_t>(windowWidth);
+    write<std::int32_t>(windowHeight);
+}
+
+void PainterCapture::endFrame()
+{
+    if (!isRecording())
+        return;
+    write(Command::FrameEnd);
+    m_inFrame = false;
+    ++m_frameCount;
+}
+
+void PainterCapture::setClipRect(const RectF &rect)
+{
+    if (!isRecording())
+        return;
+    write(Command::ClipRect);
+    write(rect);
+}
+
+void PainterCapture::drawRect(const RectF &rect, const glm::vec4 &color, int depth)
+{
+    if (!isRecording())
+        return;
+    write(Command::Rect);
+    write(rect);
+    write(color);
+    write<std::int32_t>(depth);
+}
+
+void PainterCapture::drawPixmap(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
+{
+    writeSprite(Command::Pixmap, pixmap, rect, color, depth);
+}
+
+void PainterCapture::drawGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
+{
+    writeSprite(Command::Glyph, pixmap, rect, color, depth);
+}
+
+void PainterCapture::drawSdfGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
+{
+    writeSprite(Command::SdfGlyph, pixmap, rect, color, depth);
+}
+
+void PainterCapture::writeSprite(Command command, const PackedPixmap &pixmap, const RectF &rect,
+                                 const glm::vec4 &color, int depth)
+{
+    if (!isRecording())
+        return;
+    const auto texture = textureId(pixmap.texture);
+    write(command);
+    write(texture);
+    write<std::uint8_t>(pixmap.channel);
+    write(rect);
+    write(pixmap.texCoord);
+    write(color);
+    write<std::int32_t>(depth);
+}
+
+void PainterCapture::drawCircle(const glm::vec2 &center, float radius, const glm::vec4 &color, int depth)
+{
+    if (!isRecording())
+        return;
+    write(Command::Circle);
+    write(center);
+    write(radius);
+    write(color);
+    write<std::int32_t>(depth);
+}
+
+void PainterCapture::drawCapsule(const RectF &rect, const glm::vec4 &color, int depth)
+{
+    if (!isRecording())
+        return;
+    write(Command::Capsule);
+    write(rect);
+    write(color);
+    write<std::int32_t>(depth);
+}
+
+void PainterCapture::drawRoundedRect(const RectF &rect, float cornerRadius, const glm::vec4 &color, int depth)
+{
+    if (!isRecording())
+        return;
+    write(Command::RoundedRect);
+    write(rect);
+    write(cornerRadius);
+    write(color);
+    write<std::int32_t>(depth);
+}
+
+void PainterCapture::textureUpload(const AbstractTexture *texture, const ::Pixmap &pixmap, const RectI &rect)
+{
+    if (!isRecording())
+        return;
+    auto it = m_textureIds.find(texture);
+    if (it == m_textureIds.end())
+    {
+        // first use records the contents anyway
+        textureId(texture);
+        return;
+    }
+    writeTextureSubData(it->second, pixmap, rect);
+}
+
+std::uint32_t PainterCapture::textureId(const AbstractTexture *texture)
+{
+    if (!texture)
+        return 0;
+    auto it = m_textureIds.find(texture);
+    if (it != m_textureIds.end())
+        return it->second;
+    const auto id = static_cast<std::uint32_t>(m_textureIds.size() + 1);
+    m_textureIds.emplace(texture, id);
+    // textures uploaded before the capture started need their current contents in the stream
+    if (const auto *lazyTexture = dynamic_cast<const LazyTexture *>(texture))
+        writeTextureData(id, *lazyTexture->pixmap());
+    return id;
+}
+
+void PainterCapture::writeTextureData(std::uint32_t id, const ::Pixmap &pixmap)
+{
+    write(Command::TextureData);
+    write(id);
+    write<std::int32_t>(pixmap.width);
+    write<std::int32_t>(pixmap.height);
+    write(static_cast<std::uint8_t>(pixmap.pixelType));
+    std::fwrite(pixmap.pixels.data(), 1, pixmap.pixels.size(), m_file);
+}
+
+void PainterCapture::writeTextureSubData(std::uint32_t id, const ::Pixmap &pixmap, const RectI &rect)
+{
+    write(Command::TextureSubData);
+    write(id);
+    write<std::int32_t>(pixmap.width);
+    write<std::int32_t>(pixmap.height);
+    write(static_cast<std::uint8_t>(pixmap.pixelType));
+    write(rect);
+    const auto pixelSize = pixelSizeInBytes(pixmap.pixelType);
+    for (int y = rect.min.y; y < rect.max.y; ++y)
+    {
+        const auto *row = pixmap.pixels.data() + (y * pixmap.width + rect.min.x) * pixelSize;
+        std::fwrite(row, pixelSize, rect.width(), m_file);
+    }
+}
+
+} // namespace miniui
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "util.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <unordered_map>
+
+class AbstractTexture;
+struct PackedPixmap;
+struct Pixmap;
+
+namespace miniui
+{
+
+// Records the Painter command stream and texture uploads into a compact binary file, so that production
+// workloads can be replayed against the batcher and GL backend without the app (see benchmarks/replay.cc).
+//
+// File layout: header (magic, version), then a sequence of commands, each a one-byte opcode followed by its
+// fields in native byte order. Textures are referred to by ids assigned on first use; id 0 means no texture.
+class PainterCapture : private NonCopyable
+{
+public:
+    static constexpr std::uint32_t Magic = 0x4342524f; // "ORBC"
+    static constexpr std::uint32_t Version = 5;
+
+    enum class Command : std::uint8_t
+    {
+        FrameBegin,  // i32 windowWidth, i32 windowHeight
+        FrameEnd,    //
+        ClipRect,    // RectF rect
+        Rect,        // RectF rect, vec4 color, i32 depth
+        Pixmap,      // u32 texture, u8 channel, RectF rect, RectF texCoord (in pixels), vec4 color, i32 depth
+        Glyph,       // u32 texture, u8 channel, RectF rect, RectF texCoord (in pixels), vec4 color, i32 depth
+        Circle,      // vec2 center, f32 radius, vec4 color, i32 depth
+        Capsule,     // RectF rect, vec4 color, i32 depth
+        RoundedRect, // RectF rect, f32 cornerRadius, vec4 color, i32 depth
+        TextureData,    // u32 texture, i32 width, i32 height, u8 pixelType, pixels
+        TextureSubData, // u32 texture, i32 width, i32 height, u8 pixelType, RectI rect, pixels of rect
+        SdfGlyph,       // same as Glyph
+    };
+
+    explicit PainterCapture(const std::string &path, int maxFrames = -1);
+    ~PainterCapture();
+
+    bool isValid() const { return m_file != nullptr; }
+    bool isRecording() const { return m_file != nullptr && m_inFrame; }
+    int frameCount() const { return m_frameCount; }
+
+    void beginFrame(int windowWidth, int windowHeight);
+    void endFrame();
+
+    void setClipRect(const RectF &rect);
+    void drawRect(const RectF &rect, const glm::vec4 &color, int depth);
+    void drawPixmap(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
+    void drawGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
+    void drawSdfGlyph(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
+    void drawCircle(const glm::vec2 &center, float radius, const glm::vec4 &color, int depth);
+    void drawCapsule(const RectF &rect, const glm::vec4 &color, int depth);
+    void drawRoundedRect(const RectF &rect, float cornerRadius, const glm::vec4 &color, int depth);
+
+    void textureUpload(const AbstractTexture *texture, const ::Pixmap &pixmap, const RectI &rect);
+
+private:
+    std::uint32_t textureId(const AbstractTexture *texture);
+    void writeTextureData(std::uint32_t id, const ::Pixmap &pixmap);
+    void writeTextureSubData(std::uint32_t id, const ::Pixmap &pixmap, const RectI &rect);
+    void writeSprite(Command command, const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color,
+                     int depth);
+
+    template<typename T>
+    void write(const T &value)
+    {
+        std::fwrite(&value, sizeof(T), 1, m_file);
+    }
+
+    std::FILE *m_file = nullptr;
+    std::unordered_map<const AbstractTexture *, std::uint32_t> m_textureIds;
+    int m_maxFrames;
+    int m_frameCount = 0;
+    bool m_inFrame = false;
+};
+
+} // namespace miniui
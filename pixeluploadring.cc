@@ -0,0 +1,99 @@
+#include "pixeluploadring.h"
+
+#include "buffer.h"
+#include "texture.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace gl
+{
+
+namespace
+{
+constexpr std::size_t Alignment = 16;
+}
+
+PixelUploadRing::PixelUploadRing(std::size_t slotSize, int slotCount)
+    : m_slotSize(slotSize)
+{
+    for (int i = 0; i < slotCount; ++i)
+    {
+        auto &slot = m_slots.emplace_back();
+        slot.buffer = std::make_unique<Buffer>(Buffer::Type::PixelUnpack, Buffer::Usage::StreamDraw);
+        slot.buffer->bind();
+        slot.buffer->allocate(slotSize);
+        slot.buffer->unbind();
+    }
+}
+
+PixelUploadRing::~PixelUploadRing()
+{
+    for (auto &slot : m_slots)
+    {
+        if (slot.fence)
+            glDeleteSync(slot.fence);
+    }
+}
+
+bool PixelUploadRing::isSupported()
+{
+    return GLEW_VERSION_3_2 || (GLEW_ARB_sync && GLEW_ARB_map_buffer_range);
+}
+
+bool PixelUploadRing::upload(const Texture &texture, const RectI &rect, const unsigned char *data, int rowLength,
+                             std::size_t pixelSize)
+{
+    const auto rowSize = rect.width() * pixelSize;
+    const auto size = rowSize * rect.height();
+    if (size > m_slotSize)
+        return false;
+
+    if (m_offset + size > m_slotSize)
+        nextSlot();
+
+    auto &slot = m_slots[m_current];
+    if (slot.fence)
+    {
+        // only blocks if the GPU is a whole ring behind
+        TRACE_ZONE("PixelUploadRing::wait");
+        glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+        glDeleteSync(slot.fence);
+        slot.fence = nullptr;
+    }
+
+    slot.buffer->bind();
+    auto *dest = slot.buffer->map(m_offset, size);
+    if (!dest)
+    {
+        slot.buffer->unbind();
+        return false;
+    }
+    for (int i = 0; i < rect.height(); ++i)
+        std::memcpy(dest + i * rowSize, data + i * rowLength * pixelSize, rowSize);
+    slot.buffer->unmap();
+
+    texture.setData(rect, m_offset);
+    // client memory uploads elsewhere must not see the buffer
+    slot.buffer->unbind();
+
+    m_offset = (m_offset + size + Alignment - 1) / Alignment * Alignment;
+    return true;
+}
+
+void PixelUploadRing::endFrame()
+{
+    if (m_offset > 0)
+        nextSlot();
+}
+
+void PixelUploadRing::nextSlot()
+{
+    auto &slot = m_slots[m_current];
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_current = (m_current + 1) % m_slots.size();
+    m_offset = 0;
+}
+
+} // namespace gl
@@ -0,0 +1,53 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "util.h"
+
+#include <GL/glew.h>
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace gl
+{
+
+class Buffer;
+class Texture;
+
+// Ring of pixel unpack buffers that texture uploads are staged through, so that glTexSubImage2D returns without
+// waiting for the driver to copy from client memory. Each slot is fenced when the upload phase that used it ends and
+// isn't written again until the GPU is past the fence.
+class PixelUploadRing : private NonCopyable
+{
+public:
+    static constexpr std::size_t DefaultSlotSize = 4 * 1024 * 1024;
+    static constexpr int DefaultSlotCount = 3;
+
+    explicit PixelUploadRing(std::size_t slotSize = DefaultSlotSize, int slotCount = DefaultSlotCount);
+    ~PixelUploadRing();
+
+    static bool isSupported();
+
+    // Copies `rect` of an image with rows `rowLength` pixels apart (`data` points at the first pixel of `rect`) into
+    // the ring and uploads it from there. Returns false, doing nothing, if the rect doesn't fit in a slot.
+    bool upload(const Texture &texture, const RectI &rect, const unsigned char *data, int rowLength,
+                std::size_t pixelSize);
+
+    void endFrame();
+
+private:
+    void nextSlot();
+
+    struct Slot
+    {
+        std::unique_ptr<Buffer> buffer;
+        GLsync fence = nullptr;
+    };
+    std::vector<Slot> m_slots;
+    std::size_t m_slotSize;
+    int m_current = 0;
+    std::size_t m_offset = 0;
+};
+
+} // namespace gl
@@ -1,11 +1,59 @@
 #include "pixmap.h"
 
+#include "trace.h"
+
 #include <stb_image.h>
 
+#include <algorithm>
+#include <array>
 #include <cassert>
+#include <cstdint>
+#include <fstream>
+#include <vector>
+
+namespace
+{
+std::uint32_t crc32(const unsigned char *data, std::size_t size, std::uint32_t crc = 0)
+{
+    static const auto table = [] {
+        std::array<std::uint32_t, 256> table;
+        for (std::uint32_t i = 0; i < 256; ++i)
+        {
+            std::uint32_t c = i;
+            for (int k = 0; k < 8; ++k)
+                c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }();
+    crc = ~crc;
+    for (std::size_t i = 0; i < size; ++i)
+        crc = table[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+    return ~crc;
+}
+
+void appendU32(std::vector<unsigned char> &out, std::uint32_t v)
+{
+    out.push_back(v >> 24);
+    out.push_back(v >> 16);
+    out.push_back(v >> 8);
+    out.push_back(v);
+}
+
+void appendChunk(std::vector<unsigned char> &out, const char *type, const std::vector<unsigned char> &data)
+{
+    appendU32(out, data.size());
+    const auto start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data.begin(), data.end());
+    appendU32(out, crc32(out.data() + start, out.size() - start));
+}
+} // namespace
 
 Pixmap loadPixmap(const std::string &path, bool flip)
 {
+    TRACE_ZONE("loadPixmap");
+
     if (flip)
         stbi_set_flip_vertically_on_load(1);
 
@@ -24,3 +72,84 @@ Pixmap loadPixmap(const std::string &path, bool flip)
 
     return pm;
 }
+
+Pixmap decodePixmap(std::span<const unsigned char> data, bool flip)
+{
+    TRACE_ZONE("decodePixmap");
+
+    stbi_set_flip_vertically_on_load(flip ? 1 : 0);
+
+    int width, height, channels;
+    unsigned char *pixels = stbi_load_from_memory(data.data(), data.size(), &width, &height, &channels, 4);
+    if (!pixels)
+        return {};
+
+    Pixmap pm;
+    pm.width = width;
+    pm.height = height;
+    pm.pixelType = PixelType::RGBA;
+    pm.pixels.assign(pixels, pixels + width * height * 4);
+
+    stbi_image_free(pixels);
+
+    return pm;
+}
+
+bool savePixmap(const Pixmap &pixmap, const std::string &path)
+{
+    // uncompressed (stored deflate blocks) PNG, good enough for test output
+    const auto pixelSize = pixelSizeInBytes(pixmap.pixelType);
+    const auto rowSize = pixmap.width * pixelSize;
+
+    std::vector<unsigned char> raw;
+    raw.reserve((rowSize + 1) * pixmap.height);
+    for (int i = 0; i < pixmap.height; ++i)
+    {
+        raw.push_back(0); // filter type: none
+        const auto *row = pixmap.pixels.data() + i * rowSize;
+        raw.insert(raw.end(), row, row + rowSize);
+    }
+
+    std::vector<unsigned char> zlib = {0x78, 0x01};
+    constexpr std::size_t MaxBlockSize = 0xffff;
+    std::size_t offset = 0;
+    do
+    {
+        const auto blockSize = std::min(MaxBlockSize, raw.size() - offset);
+        const bool last = offset + blockSize == raw.size();
+        zlib.push_back(last ? 1 : 0);
+        zlib.push_back(blockSize & 0xff);
+        zlib.push_back(blockSize >> 8);
+        zlib.push_back(~blockSize & 0xff);
+        zlib.push_back((~blockSize >> 8) & 0xff);
+        zlib.insert(zlib.end(), raw.begin() + offset, raw.begin() + offset + blockSize);
+        offset += blockSize;
+    } while (offset < raw.size());
+    std::uint32_t a = 1, b = 0;
+    for (auto c : raw)
+    {
+        a = (a + c) % 65521;
+        b = (b + a) % 65521;
+    }
+    appendU32(zlib, (b << 16) | a);
+
+    std::vector<unsigned char> header;
+    appendU32(header, pixmap.width);
+    appendU32(header, pixmap.height);
+    header.push_back(8);                                          // bit depth
+    header.push_back(pixmap.pixelType == PixelType::RGBA ? 6 : 0); // color type
+    header.push_back(0);                                          // compression
+    header.push_back(0);                                          // filter
+    header.push_back(0);                                          // interlace
+
+    std::vector<unsigned char> png = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'};
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", zlib);
+    appendChunk(png, "IEND", {});
+
+    std::ofstream file(path, std::ios::binary);
+    if (!file.is_open())
+        return false;
+    file.write(reinterpret_cast<const char *>(png.data()), png.size());
+    return file.good();
+}
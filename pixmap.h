@@ -2,6 +2,7 @@
 
 #include "pixeltype.h"
 
+#include <span>
 #include <string>
 #include <vector>
 
@@ -31,3 +32,5 @@ struct Pixmap
 };
 
 Pixmap loadPixmap(const std::string &path, bool flip = false);
+Pixmap decodePixmap(std::span<const unsigned char> data, bool flip = false); // contents of an image file
+bool savePixmap(const Pixmap &pixmap, const std::string &path); // PNG
@@ -1,6 +1,11 @@
 #include "pixmapcache.h"
 
+#include "ioutil.h"
 #include "log.h"
+#include "pixmap.h"
+
+#include <algorithm>
+#include <vector>
 
 namespace miniui
 {
@@ -20,25 +25,95 @@ PixmapCache::PixmapCache(TextureAtlas *textureAtlas)
 
 PixmapCache::~PixmapCache() = default;
 
+void PixmapCache::preload(std::span<const std::string_view> sources)
+{
+    std::vector<std::string> keys;
+    std::vector<std::uint64_t> hashes;
+    std::vector<Pixmap> pixmaps;
+    for (const auto source : sources)
+    {
+        auto key = std::string(source);
+        if (m_pixmaps.find(key) != m_pixmaps.end() || std::find(keys.begin(), keys.end(), key) != keys.end())
+            continue;
+        const auto path = pixmapPath(source);
+        const auto data = Util::readFile(path);
+        const auto hash = data ? Util::contentHash(*data) : 0;
+        if (auto pixmap = warmPixmap(key, hash))
+        {
+            m_pixmaps.emplace(std::move(key), Entry{pixmap, hash});
+            continue;
+        }
+        Pixmap pm = data ? decodePixmap(*data) : Pixmap{};
+        if (!pm)
+        {
+            log("Failed to load image %s\n", path.c_str());
+            m_pixmaps.emplace(std::move(key), Entry{std::nullopt, hash});
+            continue;
+        }
+        keys.push_back(std::move(key));
+        hashes.push_back(hash);
+        pixmaps.push_back(std::move(pm));
+    }
+
+    std::vector<const Pixmap *> batch;
+    batch.reserve(pixmaps.size());
+    for (const auto &pm : pixmaps)
+        batch.push_back(&pm);
+    auto packedPixmaps = m_textureAtlas->addPixmaps(batch);
+    for (std::size_t i = 0; i < keys.size(); ++i)
+        m_pixmaps.emplace(std::move(keys[i]), Entry{packedPixmaps[i], hashes[i]});
+}
+
 std::optional<PackedPixmap> PixmapCache::pixmap(std::string_view source)
 {
     auto key = std::string(source);
     auto it = m_pixmaps.find(key);
     if (it == m_pixmaps.end())
     {
-        auto pixmap = [this, &source]() -> std::optional<PackedPixmap> {
-            const auto path = pixmapPath(source);
-            Pixmap pm = loadPixmap(path);
+        const auto path = pixmapPath(source);
+        const auto data = Util::readFile(path);
+        const auto hash = data ? Util::contentHash(*data) : 0;
+        auto pixmap = warmPixmap(key, hash);
+        if (!pixmap)
+        {
+            Pixmap pm = data ? decodePixmap(*data) : Pixmap{};
             if (!pm)
-            {
                 log("Failed to load image %s\n", path.c_str());
-                return std::nullopt;
-            }
-            return m_textureAtlas->addPixmap(pm);
-        }();
-        it = m_pixmaps.emplace(std::move(key), pixmap).first;
+            else
+                pixmap = m_textureAtlas->addPixmap(pm);
+        }
+        it = m_pixmaps.emplace(std::move(key), Entry{pixmap, hash}).first;
+    }
+    return it->second.pixmap;
+}
+
+std::vector<PixmapCache::Placement> PixmapCache::placements() const
+{
+    std::vector<Placement> placements;
+    for (const auto &[source, entry] : m_pixmaps)
+    {
+        if (entry.pixmap)
+            placements.push_back({source, entry.contentHash, *entry.pixmap});
     }
-    return it->second;
+    return placements;
+}
+
+void PixmapCache::setWarmPlacements(std::vector<Placement> placements)
+{
+    m_warmPlacements = std::move(placements);
+}
+
+std::optional<PackedPixmap> PixmapCache::warmPixmap(const std::string &source, std::uint64_t contentHash)
+{
+    auto it = std::find_if(m_warmPlacements.begin(), m_warmPlacements.end(),
+                           [&source](const Placement &placement) { return placement.source == source; });
+    if (it == m_warmPlacements.end())
+        return std::nullopt;
+    std::optional<PackedPixmap> pixmap;
+    if (it->contentHash == contentHash)
+        pixmap = it->pixmap;
+    m_warmPlacements.erase(it);
+    return pixmap;
 }
 
 } // namespace miniui
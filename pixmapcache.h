@@ -4,9 +4,12 @@
 
 #include "textureatlas.h"
 
+#include <cstdint>
+#include <span>
 #include <string>
 #include <string_view>
 #include <unordered_map>
+#include <vector>
 
 class TextureAtlas;
 
@@ -21,9 +24,31 @@ public:
 
     std::optional<PackedPixmap> pixmap(std::string_view source);
 
+    // Loads the images that aren't cached yet as one batch, packed together.
+    void preload(std::span<const std::string_view> sources);
+
+    // Placements for persisting the atlas (see AtlasCache). A warm placement is used instead of decoding the image
+    // if the file still has the same content hash.
+    struct Placement
+    {
+        std::string source;
+        std::uint64_t contentHash;
+        PackedPixmap pixmap;
+    };
+    std::vector<Placement> placements() const;
+    void setWarmPlacements(std::vector<Placement> placements);
+
 private:
+    std::optional<PackedPixmap> warmPixmap(const std::string &source, std::uint64_t contentHash);
+
     TextureAtlas *m_textureAtlas;
-    std::unordered_map<std::string, std::optional<PackedPixmap>> m_pixmaps;
+    struct Entry
+    {
+        std::optional<PackedPixmap> pixmap;
+        std::uint64_t contentHash;
+    };
+    std::unordered_map<std::string, Entry> m_pixmaps;
+    std::vector<Placement> m_warmPlacements;
 };
 
 } // namespace miniui
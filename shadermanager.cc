@@ -19,6 +19,7 @@ const char *attributeName(ShaderManager::Attribute id)
             "position",
             "texCoord",
             "color",
+            "channel",
         // clang-format on
     };
     static_assert(std::extent_v<decltype(attributeNames)> == ShaderManager::NumAttributes,
@@ -66,7 +67,8 @@ std::unique_ptr<gl::ShaderProgram> loadProgram(ShaderManager::Program id)
         // text
         {"text.vert",
          "text.frag",
-         {ShaderManager::Attribute::Position, ShaderManager::Attribute::TexCoord, ShaderManager::Attribute::Color}},
+         {ShaderManager::Attribute::Position, ShaderManager::Attribute::TexCoord, ShaderManager::Attribute::Color,
+          ShaderManager::Attribute::Channel}},
         // decal
         {"decal.vert",
          "decal.frag",
@@ -75,6 +77,11 @@ std::unique_ptr<gl::ShaderProgram> loadProgram(ShaderManager::Program id)
         {"circle.vert",
          "circle.frag",
          {ShaderManager::Attribute::Position, ShaderManager::Attribute::TexCoord, ShaderManager::Attribute::Color}},
+        // SDF text
+        {"text.vert",
+         "sdftext.frag",
+         {ShaderManager::Attribute::Position, ShaderManager::Attribute::TexCoord, ShaderManager::Attribute::Color,
+          ShaderManager::Attribute::Channel}},
     };
     static_assert(std::extent_v<decltype(programSources)> == ShaderManager::NumPrograms,
                   "expected number of programs to match");
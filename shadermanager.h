@@ -25,6 +25,7 @@ public:
         Text,
         Decal,
         Circle,
+        SdfText,
         NumPrograms
     };
     void useProgram(Program program);
@@ -41,6 +42,7 @@ public:
         Position,
         TexCoord,
         Color,
+        Channel,
         NumAttributes
     };
 
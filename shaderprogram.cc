@@ -2,6 +2,7 @@
 
 #include "ioutil.h"
 #include "log.h"
+#include "trace.h"
 
 #include <fstream>
 #include <sstream>
@@ -47,6 +48,8 @@ bool ShaderProgram::addShaderSource(GLenum type, std::string_view source)
 
 bool ShaderProgram::compileAndAttachShader(GLenum type, std::string_view source)
 {
+    TRACE_ZONE("ShaderProgram::compileAndAttachShader");
+
     const auto shader = glCreateShader(type);
 
     const std::array sources = {source.data()};
@@ -77,6 +80,8 @@ bool ShaderProgram::compileAndAttachShader(GLenum type, std::string_view source)
 
 bool ShaderProgram::link()
 {
+    TRACE_ZONE("ShaderProgram::link");
+
     glLinkProgram(m_id);
 
     GLint status;
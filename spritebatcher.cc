@@ -3,6 +3,7 @@
 #include "textureatlas.h"
 #include "log.h"
 #include "system.h"
+#include "trace.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
@@ -40,14 +41,16 @@ void SpriteBatcher::addSprite(const RectF &rect, const glm::vec4 &color, int dep
 
 void SpriteBatcher::addSprite(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth)
 {
-    addSprite(pixmap.texture, rect, pixmap.texCoord, color, depth);
+    addSprite(pixmap.texture, rect, pixmap.texCoord, color, depth, pixmap.channel);
 }
 
 void SpriteBatcher::addSprite(const AbstractTexture *texture, const RectF &rect, const RectF &texRect,
-                              const glm::vec4 &color, int depth)
+                              const glm::vec4 &color, int depth, int channel)
 {
     if (m_quadCount == MaxQuadsPerBatch)
         flush();
+    if (texture)
+        texture->prepareSampling(texRect);
 
     auto &quad = m_quads[m_quadCount++];
     quad.texture = texture;
@@ -56,6 +59,7 @@ void SpriteBatcher::addSprite(const AbstractTexture *texture, const RectF &rect,
     quad.texRect = texRect;
     quad.color = color;
     quad.depth = depth;
+    quad.channel = channel;
 }
 
 void SpriteBatcher::flush()
@@ -63,6 +67,11 @@ void SpriteBatcher::flush()
     if (m_quadCount == 0)
         return;
 
+    TRACE_ZONE("SpriteBatcher::flush");
+
+    auto &stats = System::instance()->frameStats();
+    ++stats.flushes;
+
     static std::array<const Quad *, MaxQuadsPerBatch> sortedQuads;
     const auto quadsEnd = m_quads.begin() + m_quadCount;
     std::transform(m_quads.begin(), quadsEnd, sortedQuads.begin(), [](const Quad &quad) { return &quad; });
@@ -75,7 +84,7 @@ void SpriteBatcher::flush()
 
     const AbstractTexture *currentTexture = nullptr;
     std::optional<ShaderManager::Program> currentProgram = std::nullopt;
-    int positionLocation = -1, texCoordLocation = -1, colorLocation = -1;
+    int positionLocation = -1, texCoordLocation = -1, colorLocation = -1, channelLocation = -1;
 
     auto batchStart = sortedQuads.begin();
     while (batchStart != sortedQuadsEnd)
@@ -98,14 +107,19 @@ void SpriteBatcher::flush()
             m_bufferAllocated = true;
         }
 
+        // normalized here rather than when the quad is added, atlas pages may grow in between
+        const auto texScale = batchTexture ? 1.0f / glm::vec2(batchTexture->width(), batchTexture->height())
+                                           : glm::vec2(1.0f);
+
         static std::array<GLfloat, BufferCapacity> bufferData;
         auto *data = bufferData.data();
         for (auto it = batchStart; it != batchEnd; ++it)
         {
             auto *quadPtr = *it;
 
-            const auto emitVertex = [&data, color = quadPtr->color](const glm::vec2 &position,
-                                                                    const glm::vec2 &texCoord) {
+            const auto emitVertex = [&data, color = quadPtr->color,
+                                     channel = static_cast<GLfloat>(quadPtr->channel)](const glm::vec2 &position,
+                                                                                       const glm::vec2 &texCoord) {
                 *data++ = position.x;
                 *data++ = position.y;
 
@@ -116,13 +130,15 @@ void SpriteBatcher::flush()
                 *data++ = color.y;
                 *data++ = color.z;
                 *data++ = color.w;
+
+                *data++ = channel;
             };
 
             const auto &p0 = quadPtr->rect.min;
-            const auto &t0 = quadPtr->texRect.min;
+            const auto t0 = quadPtr->texRect.min * texScale;
 
             const auto &p1 = quadPtr->rect.max;
-            const auto &t1 = quadPtr->texRect.max;
+            const auto t1 = quadPtr->texRect.max * texScale;
 
             emitVertex({p0.x, p0.y}, {t0.x, t0.y});
             emitVertex({p1.x, p0.y}, {t1.x, t0.y});
@@ -139,7 +155,10 @@ void SpriteBatcher::flush()
         {
             currentTexture = batchTexture;
             if (currentTexture)
+            {
                 currentTexture->bind();
+                ++stats.textureBinds;
+            }
         }
 
         if (currentProgram != batchProgram)
@@ -150,6 +169,8 @@ void SpriteBatcher::flush()
                 glDisableVertexAttribArray(texCoordLocation);
             if (colorLocation != -1)
                 glDisableVertexAttribArray(colorLocation);
+            if (channelLocation != -1)
+                glDisableVertexAttribArray(channelLocation);
 
             currentProgram = batchProgram;
             auto *shaderManager = System::instance()->shaderManager();
@@ -181,9 +202,18 @@ void SpriteBatcher::flush()
                                       reinterpret_cast<GLvoid *>(4 * sizeof(GLfloat)));
                 glEnableVertexAttribArray(colorLocation);
             }
+
+            channelLocation = shaderManager->attributeLocation(ShaderManager::Attribute::Channel);
+            if (channelLocation != -1)
+            {
+                glVertexAttribPointer(channelLocation, 1, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                      reinterpret_cast<GLvoid *>(8 * sizeof(GLfloat)));
+                glEnableVertexAttribArray(channelLocation);
+            }
         }
 
         glDrawArrays(GL_TRIANGLES, m_bufferOffset / GLVertexSize, quadCount * 6);
+        ++stats.drawCalls;
 
         m_bufferOffset += bufferRangeSize;
         batchStart = batchEnd;
@@ -195,6 +225,8 @@ void SpriteBatcher::flush()
         glDisableVertexAttribArray(texCoordLocation);
     if (colorLocation != -1)
         glDisableVertexAttribArray(colorLocation);
+    if (channelLocation != -1)
+        glDisableVertexAttribArray(channelLocation);
 
     m_quadCount = 0;
 }
@@ -34,8 +34,9 @@ public:
 
     void addSprite(const RectF &rect, const glm::vec4 &color, int depth);
     void addSprite(const PackedPixmap &pixmap, const RectF &rect, const glm::vec4 &color, int depth);
+    // `texRect` is in pixels of `texture`; without a texture it's passed through to the program as is
     void addSprite(const AbstractTexture *texture, const RectF &rect, const RectF &texRect, const glm::vec4 &color,
-                   int depth);
+                   int depth, int channel = 0);
 
 private:
     struct Quad
@@ -46,6 +47,7 @@ private:
         RectF texRect;
         glm::vec4 color;
         int depth;
+        int channel;
     };
 
     struct Vertex
@@ -53,6 +55,7 @@ private:
         glm::vec2 position;
         glm::vec2 texCoord;
         glm::vec4 color;
+        float channel; // of the texture, see TextureAtlas::setChannelPacking
     };
 
     static constexpr int BufferCapacity = 0x100000;                       // in floats
@@ -0,0 +1,108 @@
+#include "stressscene.h"
+
+#include "fontcache.h"
+#include "miniui.h"
+#include "painter.h"
+#include "system.h"
+
+#include <algorithm>
+#include <random>
+#include <string>
+
+namespace
+{
+std::u32string toU32(const std::string &text)
+{
+    return std::u32string(text.begin(), text.end());
+}
+} // namespace
+
+StressScene::StressScene(const StressSceneParams &params)
+{
+    using namespace std::literals;
+    using namespace miniui;
+
+    auto *fontCache = System::instance()->fontCache();
+    auto *smallFont = fontCache->font("OpenSans_Regular", 32);
+    auto *tinyFont = fontCache->font("OpenSans_Regular", 20);
+
+    std::mt19937 rng(params.seed);
+    std::uniform_real_distribution<float> chance(0.0f, 1.0f);
+
+    constexpr auto CellWidth = 120.0f;
+
+    auto column = std::make_unique<Column>();
+    column->setMargins({10, 10, 10, 10});
+    column->setSpacing(5);
+
+    for (int i = 0; i < params.rows; ++i)
+    {
+        auto row = std::make_unique<Row>();
+        row->fillBackground = true;
+        row->shape = Item::Shape::RoundedRectangle;
+        row->cornerRadius = 8;
+        row->backgroundColor = glm::vec4(1, 1, 1, 0.25);
+        row->setMargins({10, 10, 10, 10});
+        row->setSpacing(1);
+
+        for (int j = 0; j < params.labelsPerRow; ++j)
+        {
+            std::unique_ptr<Item> cell;
+            if (chance(rng) < params.imageFraction)
+            {
+                auto image = std::make_unique<Image>("peppers.jpg"sv);
+                image->setFixedWidth(CellWidth);
+                image->setFixedHeight(40);
+                cell = std::move(image);
+                ++m_imageCount;
+            }
+            else
+            {
+                const auto text = "Cell " + std::to_string(i) + ":" + std::to_string(j);
+                auto label = std::make_unique<Label>(j % 2 == 0 ? smallFont : tinyFont, toU32(text));
+                label->color = glm::vec4(1, 1, 1, 1);
+                label->alignment = j % 3 == 0 ? Alignment::Left : Alignment::HCenter;
+                label->setFixedWidth(chance(rng) < params.clippedFraction ? 0.25f * CellWidth : CellWidth);
+                if (chance(rng) < params.animatedFraction)
+                    m_animatedLabels.push_back(label.get());
+                cell = std::move(label);
+                ++m_labelCount;
+            }
+
+            // wrap the cell in alternating columns and rows up to the requested depth
+            for (int k = 1; k < params.depth; ++k)
+            {
+                std::unique_ptr<Container> container;
+                if (k % 2 == 0)
+                    container = std::make_unique<Row>();
+                else
+                    container = std::make_unique<Column>();
+                container->addItem(std::move(cell));
+                cell = std::move(container);
+            }
+
+            row->addItem(std::move(cell));
+        }
+
+        column->addItem(std::move(row));
+    }
+
+    m_root = std::move(column);
+}
+
+StressScene::~StressScene() = default;
+
+void StressScene::update(float elapsed)
+{
+    ++m_frame;
+    for (std::size_t i = 0; i < m_animatedLabels.size(); ++i)
+        m_animatedLabels[i]->setText(toU32(std::to_string((m_frame + i * 7) % 1000)));
+    m_root->update(elapsed);
+}
+
+void StressScene::render(miniui::Painter *painter) const
+{
+    painter->begin();
+    m_root->render(painter, {0, 0});
+    painter->end();
+}
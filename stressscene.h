@@ -0,0 +1,48 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <memory>
+#include <vector>
+
+namespace miniui
+{
+class Item;
+class Label;
+class Painter;
+} // namespace miniui
+
+// Parameterized miniui scene for reproducible large rendering and layout workloads. Rows are built like the
+// leaderboard entries in Game: rounded rows of fixed-width labels.
+struct StressSceneParams
+{
+    int rows = 50;
+    int labelsPerRow = 8;
+    int depth = 1;                 // containers between a row and each of its labels (>= 1)
+    float clippedFraction = 0.1f;  // labels narrower than their text, forcing a clip rect
+    float imageFraction = 0.1f;    // cells showing an image instead of a label
+    float animatedFraction = 0.1f; // labels whose text changes every frame
+    unsigned seed = 1;
+};
+
+class StressScene : private NonCopyable
+{
+public:
+    explicit StressScene(const StressSceneParams &params);
+    ~StressScene();
+
+    miniui::Item *rootItem() const { return m_root.get(); }
+    int labelCount() const { return m_labelCount; }
+    int imageCount() const { return m_imageCount; }
+    int animatedLabelCount() const { return m_animatedLabels.size(); }
+
+    void update(float elapsed);
+    void render(miniui::Painter *painter) const;
+
+private:
+    std::unique_ptr<miniui::Item> m_root;
+    std::vector<miniui::Label *> m_animatedLabels;
+    int m_labelCount = 0;
+    int m_imageCount = 0;
+    int m_frame = 0;
+};
@@ -1,17 +1,33 @@
 #include "system.h"
 
+#include "atlascache.h"
 #include "fontcache.h"
 #include "painter.h"
+#include "paintercapture.h"
 #include "pixmapcache.h"
 #include "shadermanager.h"
 #include "textureatlas.h"
+#include "textureuploader.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
 
 System *System::s_instance = nullptr;
 
 namespace
 {
-constexpr auto TextureAtlasPageSize = 1024;
+// pages start small and double up to the largest texture the device supports, or this
+constexpr auto InitialTextureAtlasPageSize = 512;
+constexpr auto MaxTextureAtlasPageSize = 4096;
+
+int textureAtlasPageSize()
+{
+    GLint maxTextureSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxTextureSize);
+    return std::clamp(static_cast<int>(maxTextureSize), InitialTextureAtlasPageSize, MaxTextureAtlasPageSize);
 }
+} // namespace
 
 bool System::initialize()
 {
@@ -25,14 +41,52 @@ void System::shutdown()
 }
 
 System::System()
-    : m_shaderManager(std::make_unique<ShaderManager>())
+    : m_textureUploader(std::make_unique<TextureUploader>())
+    , m_shaderManager(std::make_unique<ShaderManager>())
     , m_uiPainter(std::make_unique<miniui::Painter>())
     , m_fontTextureAtlas(
-          std::make_unique<TextureAtlas>(TextureAtlasPageSize, TextureAtlasPageSize, PixelType::Grayscale))
-    , m_pixmapTextureAtlas(std::make_unique<TextureAtlas>(TextureAtlasPageSize, TextureAtlasPageSize, PixelType::RGBA))
+          std::make_unique<TextureAtlas>(textureAtlasPageSize(), textureAtlasPageSize(), PixelType::Grayscale))
+    , m_pixmapTextureAtlas(
+          std::make_unique<TextureAtlas>(textureAtlasPageSize(), textureAtlasPageSize(), PixelType::RGBA))
     , m_fontCache(std::make_unique<miniui::FontCache>(m_fontTextureAtlas.get()))
     , m_pixmapCache(std::make_unique<miniui::PixmapCache>(m_pixmapTextureAtlas.get()))
 {
+    m_fontTextureAtlas->setChannelPacking(true);
+    m_fontTextureAtlas->setInitialPageSize(InitialTextureAtlasPageSize, InitialTextureAtlasPageSize);
+    m_pixmapTextureAtlas->setInitialPageSize(InitialTextureAtlasPageSize, InitialTextureAtlasPageSize);
 }
 
 System::~System() = default;
+
+void System::beginFrame()
+{
+    ++m_frameNumber;
+    m_fontCache->beginFrame(m_frameNumber);
+    m_textureUploader->uploadPending();
+}
+
+bool System::loadAtlasCache(const std::string &path)
+{
+    return AtlasCache::load(path, *m_fontTextureAtlas, *m_fontCache, *m_pixmapTextureAtlas, *m_pixmapCache);
+}
+
+bool System::saveAtlasCache(const std::string &path) const
+{
+    return AtlasCache::save(path, *m_fontTextureAtlas, *m_fontCache, *m_pixmapTextureAtlas, *m_pixmapCache);
+}
+
+bool System::startCapture(const std::string &path, int maxFrames)
+{
+    m_painterCapture = std::make_unique<miniui::PainterCapture>(path, maxFrames);
+    if (!m_painterCapture->isValid())
+    {
+        m_painterCapture.reset();
+        return false;
+    }
+    return true;
+}
+
+void System::stopCapture()
+{
+    m_painterCapture.reset();
+}
@@ -1,16 +1,21 @@
 #pragma once
 
+#include "framestats.h"
+
 #include <memory>
+#include <string>
 
 class ShaderManager;
 
 class TextureAtlas;
+class TextureUploader;
 
 namespace miniui
 {
 class Painter;
 class FontCache;
 class PixmapCache;
+class PainterCapture;
 } // namespace miniui
 
 class System
@@ -30,6 +35,22 @@ public:
     miniui::Painter *uiPainter() const { return m_uiPainter.get(); }
     miniui::FontCache *fontCache() const { return m_fontCache.get(); }
     miniui::PixmapCache *pixmapCache() const { return m_pixmapCache.get(); }
+    TextureUploader *textureUploader() const { return m_textureUploader.get(); }
+
+    FrameStats &frameStats() { return m_frameStats; }
+
+    // Starts a frame before anything is drawn (Painter::begin does): runs glyph eviction and the texture upload
+    // phase.
+    void beginFrame();
+    int frameNumber() const { return m_frameNumber; }
+
+    // See AtlasCache. Loading must happen before any font or image is used.
+    bool loadAtlasCache(const std::string &path);
+    bool saveAtlasCache(const std::string &path) const;
+
+    bool startCapture(const std::string &path, int maxFrames = -1);
+    void stopCapture();
+    miniui::PainterCapture *painterCapture() const { return m_painterCapture.get(); }
 
 private:
     System();
@@ -37,10 +58,14 @@ private:
 
     static System *s_instance;
 
+    std::unique_ptr<TextureUploader> m_textureUploader; // outlives the textures it uploads to
     std::unique_ptr<ShaderManager> m_shaderManager;
     std::unique_ptr<miniui::Painter> m_uiPainter;
     std::unique_ptr<TextureAtlas> m_fontTextureAtlas;
     std::unique_ptr<TextureAtlas> m_pixmapTextureAtlas;
     std::unique_ptr<miniui::FontCache> m_fontCache;
     std::unique_ptr<miniui::PixmapCache> m_pixmapCache;
+    FrameStats m_frameStats;
+    int m_frameNumber = 0;
+    std::unique_ptr<miniui::PainterCapture> m_painterCapture;
 };
@@ -0,0 +1,312 @@
+#include "framebuffer.h"
+#include "framestats.h"
+#include "game.h"
+#include "headlesscontext.h"
+#include "miniui.h"
+#include "painter.h"
+#include "pixmap.h"
+#include "stressscene.h"
+#include "system.h"
+#include "fontcache.h"
+#include "log.h"
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Golden-image regression harness. Renders each named scene headlessly into a framebuffer, compares the result
+// against tests/golden/<scene>.png and checks the scene's FrameStats budgets. Run from the repository root:
+//
+//   golden [--update] [--tolerance=N] [--golden-dir=DIR] [--output-dir=DIR] [scene...]
+//
+// --update rewrites the stored images instead of comparing. On a mismatch the rendered image and a difference
+// mask are written to the output directory.
+
+namespace
+{
+
+constexpr auto SceneWidth = 800;
+constexpr auto SceneHeight = 600;
+constexpr auto FrameCount = 3; // the last frame is compared, budgets apply to all of them
+
+struct Budget
+{
+    int maxDrawCalls;              // per frame
+    int maxFlushes;                // per frame
+    std::size_t maxBytesUploaded;  // whole scene
+};
+
+using RenderFunction = std::function<void()>;
+
+struct Scene
+{
+    const char *name;
+    Budget budget;
+    std::function<RenderFunction()> create;
+};
+
+void beginFrame()
+{
+    glViewport(0, 0, SceneWidth, SceneHeight);
+    glClearColor(0, 0.5, 1, 1);
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+void endFrame()
+{
+    glDisable(GL_SCISSOR_TEST);
+}
+
+RenderFunction renderItem(std::shared_ptr<miniui::Item> item)
+{
+    return [item] {
+        auto *painter = System::instance()->uiPainter();
+        beginFrame();
+        painter->begin();
+        item->render(painter, {20, 20});
+        painter->end();
+        endFrame();
+    };
+}
+
+// a small margin above what each scene measures, so that a regression in batching or uploads shows up
+constexpr std::size_t KiB = 1024;
+
+const std::vector<Scene> &scenes()
+{
+    static const std::vector<Scene> scenes = {
+        {"leaderboard", {8, 2, 400 * KiB},
+         [] {
+             auto game = std::make_shared<Game>();
+             game->resize(SceneWidth, SceneHeight);
+             return [game] {
+                 game->update(0.0f);
+                 game->render();
+             };
+         }},
+        {"stress", {32, 20, 350 * KiB},
+         [] {
+             StressSceneParams params;
+             params.rows = 20;
+             params.labelsPerRow = 6;
+             params.depth = 3;
+             params.clippedFraction = 0.2f;
+             params.imageFraction = 0.1f;
+             params.animatedFraction = 0.0f; // keep the image stable
+             auto scene = std::make_shared<StressScene>(params);
+             return [scene] {
+                 beginFrame();
+                 scene->render(System::instance()->uiPainter());
+                 endFrame();
+             };
+         }},
+        {"shapes", {3, 1, 0},
+         [] {
+             return [] {
+                 auto *painter = System::instance()->uiPainter();
+                 beginFrame();
+                 painter->begin();
+                 painter->drawRect({{20, 20}, {220, 120}}, {1, 0, 0, 0.5}, 0);
+                 painter->drawCircle({400, 200}, 160, {1, 1, 1, 0.5}, 1);
+                 painter->drawCapsule({{40, 160}, {80, 300}}, {1, 1, 1, 0.5}, 1);
+                 painter->drawCapsule({{200, 400}, {400, 450}}, {1, 1, 1, 0.5}, 1);
+                 painter->drawRoundedRect({{450, 420}, {700, 540}}, 12.0f, {1, 1, 1, 0.5}, 1);
+                 painter->end();
+                 endFrame();
+             };
+         }},
+        {"paragraph", {2, 1, 20 * KiB},
+         [] {
+             auto *font = System::instance()->fontCache()->font("OpenSans_Regular", 20);
+             const std::string_view text =
+                 "Lorem ipsum dolor sit amet, consectetur adipiscing elit, sed do eiusmod tempor incididunt ut labore "
+                 "et dolore magna aliqua. Ut enim ad minim veniam, quis nostrud exercitation ullamco laboris nisi ut "
+                 "aliquip ex ea commodo consequat. Duis aute irure dolor in reprehenderit in voluptate velit esse "
+                 "cillum dolore eu fugiat nulla pariatur.";
+             auto item = std::make_shared<miniui::MultiLineText>(font, std::u32string(text.begin(), text.end()));
+             item->color = glm::vec4(1, 1, 1, 1);
+             item->setFixedWidth(500);
+             return renderItem(item);
+         }},
+    };
+    return scenes;
+}
+
+struct Options
+{
+    bool update = false;
+    int tolerance = 2;                // per channel
+    double maxMismatchFraction = 1e-3; // of all pixels
+    std::string goldenDir = "tests/golden";
+    std::string outputDir = ".";
+    std::vector<std::string> sceneNames;
+};
+
+struct Comparison
+{
+    std::size_t mismatched = 0;
+    int maxDifference = 0;
+    Pixmap diff;
+};
+
+Comparison compare(const Pixmap &actual, const Pixmap &expected, int tolerance)
+{
+    Comparison result;
+    result.diff = Pixmap(actual.width, actual.height, PixelType::Grayscale);
+    for (int i = 0; i < actual.width * actual.height; ++i)
+    {
+        int difference = 0;
+        for (int c = 0; c < 4; ++c)
+            difference = std::max(difference, std::abs(actual.pixels[i * 4 + c] - expected.pixels[i * 4 + c]));
+        result.maxDifference = std::max(result.maxDifference, difference);
+        if (difference > tolerance)
+        {
+            ++result.mismatched;
+            result.diff.pixels[i] = 255;
+        }
+    }
+    return result;
+}
+
+bool runScene(const Scene &scene, const Options &options)
+{
+    // every scene starts with empty caches so upload budgets don't depend on the order scenes run in
+    System::shutdown();
+    System::initialize();
+
+    gl::Framebuffer framebuffer(SceneWidth, SceneHeight);
+    framebuffer.bind();
+
+    System::instance()->uiPainter()->setWindowSize(SceneWidth, SceneHeight);
+    const auto render = scene.create();
+
+    auto &stats = System::instance()->frameStats();
+    int maxDrawCalls = 0;
+    int maxFlushes = 0;
+    std::size_t bytesUploaded = 0;
+    for (int i = 0; i < FrameCount; ++i)
+    {
+        stats.reset();
+        render();
+        maxDrawCalls = std::max(maxDrawCalls, stats.drawCalls);
+        maxFlushes = std::max(maxFlushes, stats.flushes);
+        bytesUploaded += stats.bytesUploaded;
+    }
+
+    const auto actual = framebuffer.readPixels();
+    gl::Framebuffer::unbind();
+
+    bool ok = true;
+
+    log("%-12s draws %d/%d, flushes %d/%d, uploaded %zu/%zu bytes\n", scene.name, maxDrawCalls,
+        scene.budget.maxDrawCalls, maxFlushes, scene.budget.maxFlushes, bytesUploaded, scene.budget.maxBytesUploaded);
+    if (maxDrawCalls > scene.budget.maxDrawCalls || maxFlushes > scene.budget.maxFlushes ||
+        bytesUploaded > scene.budget.maxBytesUploaded)
+    {
+        log("%-12s FAIL: over budget\n", scene.name);
+        ok = false;
+    }
+
+    const auto goldenPath = options.goldenDir + "/" + scene.name + ".png";
+    if (options.update)
+    {
+        if (!savePixmap(actual, goldenPath))
+        {
+            log("%-12s FAIL: couldn't write %s\n", scene.name, goldenPath.c_str());
+            return false;
+        }
+        log("%-12s updated %s\n", scene.name, goldenPath.c_str());
+        return ok;
+    }
+
+    const auto expected = loadPixmap(goldenPath);
+    if (!expected)
+    {
+        log("%-12s FAIL: missing %s (run with --update to create it)\n", scene.name, goldenPath.c_str());
+        return false;
+    }
+    if (expected.width != actual.width || expected.height != actual.height)
+    {
+        log("%-12s FAIL: size mismatch (%dx%d, expected %dx%d)\n", scene.name, actual.width, actual.height,
+            expected.width, expected.height);
+        return false;
+    }
+
+    const auto comparison = compare(actual, expected, options.tolerance);
+    const auto mismatchFraction = static_cast<double>(comparison.mismatched) / (actual.width * actual.height);
+    if (mismatchFraction > options.maxMismatchFraction)
+    {
+        const auto basePath = options.outputDir + "/" + scene.name;
+        savePixmap(actual, basePath + ".actual.png");
+        savePixmap(comparison.diff, basePath + ".diff.png");
+        log("%-12s FAIL: %zu pixels differ (max difference %d), see %s.actual.png\n", scene.name,
+            comparison.mismatched, comparison.maxDifference, basePath.c_str());
+        return false;
+    }
+
+    if (ok)
+        log("%-12s ok\n", scene.name);
+    return ok;
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string_view arg = argv[i];
+        const auto value = [&arg](std::string_view option) -> std::optional<std::string> {
+            if (arg.substr(0, option.size()) != option)
+                return std::nullopt;
+            return std::string(arg.substr(option.size()));
+        };
+        if (arg == "--update")
+            options.update = true;
+        else if (auto v = value("--tolerance="))
+            options.tolerance = std::atoi(v->c_str());
+        else if (auto v = value("--golden-dir="))
+            options.goldenDir = *v;
+        else if (auto v = value("--output-dir="))
+            options.outputDir = *v;
+        else if (arg.substr(0, 2) == "--")
+        {
+            log("Usage: %s [--update] [--tolerance=N] [--golden-dir=DIR] [--output-dir=DIR] [scene...]\n", argv[0]);
+            return 1;
+        }
+        else
+            options.sceneNames.emplace_back(arg);
+    }
+
+    HeadlessContext context;
+    if (!context.isValid())
+        return 1;
+
+    int failures = 0;
+    int ran = 0;
+    for (const auto &scene : scenes())
+    {
+        if (!options.sceneNames.empty() &&
+            std::find(options.sceneNames.begin(), options.sceneNames.end(), scene.name) == options.sceneNames.end())
+            continue;
+        ++ran;
+        if (!runScene(scene, options))
+            ++failures;
+    }
+
+    System::shutdown();
+
+    log("%d of %d scenes passed\n", ran - failures, ran);
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+#include "textrun.h"
+
+#include "font.h"
+
+namespace miniui
+{
+
+TextRun::TextRun(Font *font, std::u32string_view text)
+    : m_font(font)
+    , m_text(text)
+{
+    reshape();
+}
+
+bool TextRun::isValid() const
+{
+    return !m_font || m_generation == m_font->generation();
+}
+
+void TextRun::reshape()
+{
+    m_glyphs.clear();
+    m_width = 0.0f;
+    if (!m_font)
+        return;
+
+    m_glyphs.reserve(m_text.size());
+    char32_t previous = 0;
+    for (auto ch : m_text)
+    {
+        const auto slot = m_font->glyphSlot(ch);
+        if (slot < 0)
+            continue;
+        if (previous)
+            m_width += m_font->kerning(previous, ch);
+        previous = ch;
+        m_glyphs.push_back(Glyph{slot, ch, m_width});
+        m_width += m_font->glyphAt(slot).advanceWidth;
+    }
+    m_generation = m_font->generation();
+}
+
+} // namespace miniui
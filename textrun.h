@@ -0,0 +1,43 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace miniui
+{
+class Font;
+
+// A string laid out in a font once: glyph slots, pen positions (with kerning) and the total width, so that drawing
+// static text doesn't look glyphs up again every frame. Re-shapes itself when the font's glyphs are evicted.
+class TextRun
+{
+public:
+    TextRun() = default;
+    TextRun(Font *font, std::u32string_view text);
+
+    Font *font() const { return m_font; }
+    const std::u32string &text() const { return m_text; }
+    float width() const { return m_width; }
+
+    // false once the font's generation changed, see reshape()
+    bool isValid() const;
+    void reshape();
+
+    struct Glyph
+    {
+        int slot; // see Font::glyphSlot()
+        char32_t codepoint;
+        float x;
+    };
+    const std::vector<Glyph> &glyphs() const { return m_glyphs; }
+
+private:
+    Font *m_font = nullptr;
+    std::u32string m_text;
+    std::vector<Glyph> m_glyphs;
+    float m_width = 0.0f;
+    int m_generation = 0;
+};
+
+} // namespace miniui
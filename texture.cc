@@ -53,19 +53,47 @@ void Texture::initialize()
     glTexParameteri(Target, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
+    allocate();
+}
+
+void Texture::allocate()
+{
     glTexImage2D(Target, 0, toGLInternalFormat(m_pixelType), m_width, m_height, 0, toGLFormat(m_pixelType),
                  GL_UNSIGNED_BYTE, nullptr);
 }
 
+void Texture::resize(int width, int height)
+{
+    m_width = width;
+    m_height = height;
+    bind();
+    allocate();
+}
+
 void Texture::setData(const unsigned char *data) const
 {
-    gpuSetData(data);
+    gpuSetData(RectI{{0, 0}, {m_width, m_height}}, data, m_width);
+}
+
+void Texture::setData(const RectI &rect, const unsigned char *data, int rowLength) const
+{
+    gpuSetData(rect, data, rowLength);
+}
+
+void Texture::setData(const RectI &rect, std::size_t offset) const
+{
+    gpuSetData(rect, reinterpret_cast<const unsigned char *>(offset), rect.width());
 }
 
-void Texture::gpuSetData(const unsigned char *data) const
+void Texture::gpuSetData(const RectI &rect, const unsigned char *data, int rowLength) const
 {
     bind();
-    glTexSubImage2D(Target, 0, 0, 0, m_width, m_height, toGLFormat(m_pixelType), GL_UNSIGNED_BYTE, data);
+    if (rowLength != rect.width())
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, rowLength);
+    glTexSubImage2D(Target, 0, rect.min.x, rect.min.y, rect.width(), rect.height(), toGLFormat(m_pixelType),
+                    GL_UNSIGNED_BYTE, data);
+    if (rowLength != rect.width())
+        glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
 }
 
 void Texture::bind() const
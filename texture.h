@@ -2,6 +2,7 @@
 
 #include "abstracttexture.h"
 #include "pixeltype.h"
+#include "util.h"
 
 #include <GL/glew.h>
 
@@ -21,9 +22,16 @@ public:
     ~Texture() override;
 
     void setData(const unsigned char *data) const;
+    // `data` points at the first pixel of `rect`, rows are `rowLength` pixels apart
+    void setData(const RectI &rect, const unsigned char *data, int rowLength) const;
+    // from the pixel unpack buffer currently bound, tightly packed rows starting at `offset`
+    void setData(const RectI &rect, std::size_t offset) const;
 
-    int width() const { return m_width; }
-    int height() const { return m_height; }
+    // Reallocates the storage, the contents are undefined afterwards.
+    void resize(int width, int height);
+
+    int width() const override { return m_width; }
+    int height() const override { return m_height; }
 
     void bind() const override;
 
@@ -31,7 +39,8 @@ public:
 
 private:
     void initialize();
-    void gpuSetData(const unsigned char *data) const;
+    void allocate();
+    void gpuSetData(const RectI &rect, const unsigned char *data, int rowLength) const;
 
     int m_width;
     int m_height;
@@ -2,16 +2,29 @@
 
 #include "log.h"
 #include "pixmap.h"
+#include "system.h"
+#include "textureuploader.h"
+#include "trace.h"
 
-TextureAtlas::TextureAtlas(int pageWidth, int pageHeight, PixelType pixelType)
+#include <algorithm>
+#include <numeric>
+
+TextureAtlas::TextureAtlas(int pageWidth, int pageHeight, PixelType pixelType, TextureAtlasPage::Packer packer)
     : m_pageWidth(pageWidth)
     , m_pageHeight(pageHeight)
+    , m_initialPageSize(pageWidth, pageHeight)
     , m_pixelType(pixelType)
+    , m_packer(packer)
 {
 }
 
 TextureAtlas::~TextureAtlas() = default;
 
+void TextureAtlas::setInitialPageSize(int width, int height)
+{
+    m_initialPageSize = glm::min(glm::ivec2(width, height), glm::ivec2(m_pageWidth, m_pageHeight));
+}
+
 int TextureAtlas::pageWidth() const
 {
     return m_pageWidth;
@@ -27,7 +40,93 @@ PixelType TextureAtlas::pixelType() const
     return m_pixelType;
 }
 
-std::optional<PackedPixmap> TextureAtlas::addPixmap(const Pixmap &pm)
+void TextureAtlas::setChannelPacking(bool enabled)
+{
+    assert(m_pages.empty());
+    assert(!enabled || m_pixelType == PixelType::Grayscale);
+    m_channelPacking = enabled;
+}
+
+bool TextureAtlas::channelPacking() const
+{
+    return m_channelPacking;
+}
+
+std::optional<PackedPixmap> TextureAtlas::addPixmap(const Pixmap &pm, UploadPriority priority)
+{
+    auto placement = insert(pm);
+    if (!placement)
+        return std::nullopt;
+
+    // the margin was cleared too
+    const auto Margin = glm::ivec2(TextureAtlasPage::Margin);
+    markDirty(*placement->entry, RectI{placement->rect.min - Margin, placement->rect.max + Margin}, priority);
+
+    return packedPixmap(*placement);
+}
+
+std::vector<std::optional<PackedPixmap>> TextureAtlas::addPixmaps(std::span<const Pixmap *const> pixmaps,
+                                                                  UploadPriority priority)
+{
+    TRACE_ZONE("TextureAtlas::addPixmaps");
+
+    // tallest first, then widest, packs tighter than arrival order
+    std::vector<std::size_t> order(pixmaps.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&pixmaps](std::size_t lhs, std::size_t rhs) {
+        if (pixmaps[lhs]->height != pixmaps[rhs]->height)
+            return pixmaps[lhs]->height > pixmaps[rhs]->height;
+        return pixmaps[lhs]->width > pixmaps[rhs]->width;
+    });
+
+    std::vector<std::optional<PackedPixmap>> result(pixmaps.size());
+    std::vector<std::pair<PageTexture *, RectI>> dirtyRects; // one per page
+    for (const auto index : order)
+    {
+        auto placement = insert(*pixmaps[index]);
+        if (!placement)
+            continue;
+        result[index] = packedPixmap(*placement);
+
+        const auto Margin = glm::ivec2(TextureAtlasPage::Margin);
+        const auto rect = RectI{placement->rect.min - Margin, placement->rect.max + Margin};
+        auto it = std::find_if(dirtyRects.begin(), dirtyRects.end(),
+                               [&placement](const auto &dirty) { return dirty.first == placement->entry; });
+        if (it == dirtyRects.end())
+            dirtyRects.emplace_back(placement->entry, rect);
+        else
+            it->second |= rect;
+    }
+
+    for (const auto &[entry, rect] : dirtyRects)
+        markDirty(*entry, rect, priority);
+
+    return result;
+}
+
+std::optional<TextureAtlas::Reservation> TextureAtlas::reserve(int width, int height)
+{
+    const auto placement = reserveRect(width, height);
+    if (!placement)
+        return std::nullopt;
+
+    Reservation reservation;
+    reservation.pixels = placement->entry->page.pixelData(placement->rect.min);
+    reservation.stride = placement->entry->page.pixmap()->width * pixelSizeInBytes(m_pixelType);
+    reservation.packedPixmap = packedPixmap(*placement);
+    reservation.entry = placement->entry;
+    return reservation;
+}
+
+void TextureAtlas::commit(const Reservation &reservation, UploadPriority priority)
+{
+    const auto min = glm::ivec2(reservation.packedPixmap.texCoord.min);
+    const auto size = glm::ivec2(reservation.packedPixmap.width, reservation.packedPixmap.height);
+    const auto Margin = glm::ivec2(TextureAtlasPage::Margin);
+    markDirty(*reservation.entry, RectI{min - Margin, min + size + Margin}, priority);
+}
+
+std::optional<TextureAtlas::Placement> TextureAtlas::insert(const Pixmap &pm)
 {
     if (pm.pixelType != m_pixelType)
     {
@@ -35,60 +134,271 @@ std::optional<PackedPixmap> TextureAtlas::addPixmap(const Pixmap &pm)
         return std::nullopt;
     }
 
-    if (pm.width > m_pageWidth || pm.height > m_pageHeight)
+    const auto placement = reserveRect(pm.width, pm.height);
+    if (!placement)
+        return std::nullopt;
+
+    placement->entry->page.write(placement->rect.min, pm);
+    return placement;
+}
+
+std::optional<TextureAtlas::Placement> TextureAtlas::reserveRect(int width, int height)
+{
+    constexpr auto Margin = TextureAtlasPage::Margin;
+    if (width + 2 * Margin > m_pageWidth || height + 2 * Margin > m_pageHeight)
     {
         log("Pixmap too large for texture atlas\n");
         return std::nullopt;
     }
 
-    std::optional<RectF> texCoord;
-    LazyTexture *texture = nullptr;
+    // Pages drawn from recently come first, so new pixmaps tend to land in textures that are bound anyway.
+    // TextureAtlasPage::insert rejects pages that can't fit the pixmap without searching them.
+    const auto recentFrame = System::instance()->frameNumber() - 1;
+    for (const bool recent : {true, false})
+    {
+        for (auto &page : m_pages)
+        {
+            if ((page->texture->lastBoundFrame() >= recentFrame) != recent)
+                continue;
+            if (auto rect = page->page.reserve(width, height))
+                return Placement{page.get(), *rect};
+        }
+    }
 
-    for (auto &entry : m_pages)
+    // the newest page grows before another one is opened, all the others are as large as they get
+    if (!m_pages.empty())
     {
-        if ((texCoord = entry->page.insert(pm)))
+        auto *entry = m_pages.back().get();
+        while (canGrow(*entry))
         {
-            entry->texture.markDirty();
-            texture = &entry->texture;
-            break;
+            grow(*entry);
+            if (auto rect = entry->page.reserve(width, height))
+                return Placement{entry, *rect};
         }
     }
 
-    if (!texCoord)
+    auto *entry = addPage(
+        std::make_unique<PageTexture>(m_initialPageSize.x, m_initialPageSize.y, m_pixelType, m_packer));
+    for (;;)
     {
-        m_pages.emplace_back(new PageTexture(m_pageWidth, m_pageHeight, m_pixelType));
-        auto &entry = m_pages.back();
-        texCoord = entry->page.insert(pm);
-        if (!texCoord)
+        if (auto rect = entry->page.reserve(width, height))
+            return Placement{entry, *rect};
+        if (!canGrow(*entry))
         {
             // shouldn't ever happen
             assert(false);
             return std::nullopt;
         }
-        texture = &entry->texture;
+        grow(*entry);
     }
+}
 
-    PackedPixmap packedPixmap;
-    packedPixmap.width = pm.width;
-    packedPixmap.height = pm.height;
-    packedPixmap.texCoord = *texCoord;
-    packedPixmap.texture = texture;
+bool TextureAtlas::canGrow(const PageTexture &entry) const
+{
+    const auto *pixmap = entry.page.pixmap();
+    return entry.page.canGrow() && (pixmap->width < m_pageWidth || pixmap->height < m_pageHeight);
+}
+
+void TextureAtlas::grow(PageTexture &entry)
+{
+    const auto *pixmap = entry.page.pixmap();
+    const auto size = glm::min(2 * glm::ivec2(pixmap->width, pixmap->height), glm::ivec2(m_pageWidth, m_pageHeight));
+    entry.page.grow(size.x, size.y);
+
+    if (entry.group)
+    {
+        // the group is as large as its largest page
+        auto &group = *entry.group;
+        if (size.x > group.pixmap.width || size.y > group.pixmap.height)
+        {
+            const auto groupSize = glm::max(size, glm::ivec2(group.pixmap.width, group.pixmap.height));
+            Pixmap grown(groupSize.x, groupSize.y, PixelType::RGBA);
+            const auto srcSpan = group.pixmap.width * 4;
+            for (int i = 0; i < group.pixmap.height; ++i)
+            {
+                const auto *src = group.pixmap.pixels.data() + i * srcSpan;
+                std::copy(src, src + srcSpan, grown.pixels.data() + i * groupSize.x * 4);
+            }
+            group.pixmap = std::move(grown);
+        }
+        else
+        {
+            return;
+        }
+    }
+    entry.texture->resize();
 
+    // Whatever was drawn from the texture so far must still be there when the batch is flushed, so the old contents
+    // can't wait for the next frame's upload budget.
+    System::instance()->textureUploader()->flush(entry.texture);
+}
+
+PackedPixmap TextureAtlas::packedPixmap(const Placement &placement) const
+{
+    PackedPixmap packedPixmap;
+    packedPixmap.width = placement.rect.width();
+    packedPixmap.height = placement.rect.height();
+    packedPixmap.texCoord = RectF{glm::vec2(placement.rect.min), glm::vec2(placement.rect.max)};
+    packedPixmap.texture = placement.entry->texture;
+    packedPixmap.channel = placement.entry->channel;
     return packedPixmap;
 }
 
+TextureAtlas::PageTexture *TextureAtlas::addPage(std::unique_ptr<PageTexture> page)
+{
+    if (m_channelPacking)
+    {
+        const auto channel = static_cast<int>(m_pages.size() % 4);
+        if (channel == 0)
+        {
+            const auto *pixmap = page->page.pixmap();
+            m_channelGroups.push_back(std::make_unique<ChannelGroup>(pixmap->width, pixmap->height));
+        }
+        auto *group = m_channelGroups.back().get();
+        page->texture = &group->texture;
+        page->group = group;
+        page->channel = channel;
+    }
+    else
+    {
+        page->ownTexture = std::make_unique<LazyTexture>(page->page.pixmap());
+        page->texture = page->ownTexture.get();
+    }
+    m_pages.push_back(std::move(page));
+    return m_pages.back().get();
+}
+
+void TextureAtlas::markDirty(PageTexture &entry, const RectI &rect, UploadPriority priority)
+{
+    if (entry.group)
+    {
+        // the page's pixmap stays the source of truth, the group texture mirrors it
+        const auto &source = *entry.page.pixmap();
+        auto &target = entry.group->pixmap;
+        const auto clipped = rect.intersected(RectI{{0, 0}, {source.width, source.height}});
+        for (int y = clipped.min.y; y < clipped.max.y; ++y)
+        {
+            const auto *src = source.pixels.data() + y * source.width;
+            auto *dest = target.pixels.data() + y * target.width * 4 + entry.channel;
+            for (int x = clipped.min.x; x < clipped.max.x; ++x)
+                dest[x * 4] = src[x];
+        }
+    }
+    entry.texture->markDirty(rect, priority);
+}
+
+std::vector<std::size_t> TextureAtlas::repack(const std::vector<PackedPixmap *> &pixmaps)
+{
+    TRACE_ZONE("TextureAtlas::repack");
+
+    auto oldPages = std::move(m_pages);
+    auto oldChannelGroups = std::move(m_channelGroups);
+    m_pages.clear();
+    m_channelGroups.clear();
+
+    const auto pixelSize = pixelSizeInBytes(m_pixelType);
+
+    std::vector<std::size_t> packed; // indices into `pixmaps`
+    std::vector<std::size_t> lost;
+    std::vector<Pixmap> contents;
+    packed.reserve(pixmaps.size());
+    contents.reserve(pixmaps.size());
+    for (std::size_t i = 0; i < pixmaps.size(); ++i)
+    {
+        auto *pixmap = pixmaps[i];
+        auto it = std::find_if(oldPages.begin(), oldPages.end(), [pixmap](const auto &page) {
+            return page->texture == pixmap->texture && page->channel == pixmap->channel;
+        });
+        if (it == oldPages.end())
+        {
+            log("Pixmap not in texture atlas\n");
+            lost.push_back(i);
+            continue;
+        }
+
+        const auto &source = *(*it)->page.pixmap();
+        const auto min = glm::ivec2(pixmap->texCoord.min);
+        auto &content = contents.emplace_back(pixmap->width, pixmap->height, m_pixelType);
+        for (int i = 0; i < content.height; ++i)
+        {
+            const auto *src = source.pixels.data() + ((min.y + i) * source.width + min.x) * pixelSize;
+            std::copy(src, src + content.width * pixelSize, content.pixels.data() + i * content.width * pixelSize);
+        }
+        packed.push_back(i);
+    }
+
+    std::vector<const Pixmap *> sources;
+    sources.reserve(contents.size());
+    for (const auto &content : contents)
+        sources.push_back(&content);
+    const auto repacked = addPixmaps(sources);
+    for (std::size_t i = 0; i < packed.size(); ++i)
+    {
+        if (repacked[i])
+            *pixmaps[packed[i]] = *repacked[i];
+        else
+            lost.push_back(packed[i]);
+    }
+
+    auto *uploader = System::instance()->textureUploader();
+    for (auto &page : m_pages)
+        uploader->flush(page->texture);
+    return lost;
+}
+
 int TextureAtlas::pageCount() const
 {
     return m_pages.size();
 }
 
+int TextureAtlas::textureCount() const
+{
+    return m_channelPacking ? m_channelGroups.size() : m_pages.size();
+}
+
 const TextureAtlasPage &TextureAtlas::page(int index) const
 {
     return m_pages[index]->page;
 }
 
-TextureAtlas::PageTexture::PageTexture(int width, int height, PixelType pixelType)
-    : page(width, height, pixelType)
-    , texture(page.pixmap())
+int TextureAtlas::restorePage(Pixmap pixmap)
+{
+    assert(pixmap.width <= m_pageWidth && pixmap.height <= m_pageHeight && pixmap.pixelType == m_pixelType);
+    const auto size = glm::ivec2(pixmap.width, pixmap.height);
+    auto *entry = addPage(std::make_unique<PageTexture>(std::move(pixmap)));
+    markDirty(*entry, RectI{{0, 0}, size}, UploadPriority::Low);
+    return m_pages.size() - 1;
+}
+
+std::optional<std::pair<int, RectI>> TextureAtlas::locate(const PackedPixmap &pixmap) const
+{
+    auto it = std::find_if(m_pages.begin(), m_pages.end(), [&pixmap](const auto &page) {
+        return page->texture == pixmap.texture && page->channel == pixmap.channel;
+    });
+    if (it == m_pages.end())
+        return std::nullopt;
+    const auto min = glm::ivec2(pixmap.texCoord.min);
+    return std::make_pair(static_cast<int>(it - m_pages.begin()),
+                          RectI{min, min + glm::ivec2(pixmap.width, pixmap.height)});
+}
+
+PackedPixmap TextureAtlas::packedPixmap(int pageIndex, const RectI &rect) const
+{
+    return packedPixmap(Placement{m_pages[pageIndex].get(), rect});
+}
+
+TextureAtlas::ChannelGroup::ChannelGroup(int width, int height)
+    : pixmap(width, height, PixelType::RGBA)
+    , texture(&pixmap)
+{
+}
+
+TextureAtlas::PageTexture::PageTexture(Pixmap pixmap)
+    : page(std::move(pixmap))
+{
+}
+
+TextureAtlas::PageTexture::PageTexture(int width, int height, PixelType pixelType, TextureAtlasPage::Packer packer)
+    : page(width, height, pixelType, packer)
 {
 }
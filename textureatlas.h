@@ -5,7 +5,10 @@
 #include "textureatlaspage.h"
 #include "util.h"
 
+#include <memory>
 #include <optional>
+#include <utility>
+#include <span>
 #include <vector>
 
 struct Pixmap;
@@ -14,34 +17,107 @@ struct PackedPixmap
 {
     int width;
     int height;
-    RectF texCoord;
+    RectF texCoord; // in pixels of `texture`
     const AbstractTexture *texture;
+    int channel = 0; // of `texture` that holds the pixmap, for channel-packed atlases
 };
 
 class TextureAtlas
 {
+    struct PageTexture;
+
 public:
-    TextureAtlas(int pageWidth, int pageHeight, PixelType pixelType);
+    TextureAtlas(int pageWidth, int pageHeight, PixelType pixelType,
+                 TextureAtlasPage::Packer packer = TextureAtlasPage::Packer::Skyline);
     ~TextureAtlas();
 
-    int pageWidth() const;
+    // Pages start at this size and double in place until they reach pageWidth() x pageHeight(), only then is
+    // another page opened. By default pages start at full size.
+    void setInitialPageSize(int width, int height);
+
+    int pageWidth() const; // the largest a page gets
     int pageHeight() const;
     PixelType pixelType() const;
 
-    std::optional<PackedPixmap> addPixmap(const Pixmap &pixmap);
+    // Grayscale atlases only, before anything is added: stores four pages in the R, G, B and A channels of one RGBA
+    // texture, so glyphs from four pages can be drawn without switching textures. Packed pixmaps report their
+    // channel.
+    void setChannelPacking(bool enabled);
+    bool channelPacking() const;
+
+    std::optional<PackedPixmap> addPixmap(const Pixmap &pixmap, UploadPriority priority = UploadPriority::High);
+
+    // Packs the whole set, largest first, and marks one dirty region per page touched. Results are in the order of
+    // `pixmaps`.
+    std::vector<std::optional<PackedPixmap>> addPixmaps(std::span<const Pixmap *const> pixmaps,
+                                                        UploadPriority priority = UploadPriority::High);
+
+    // Zero-copy alternative to addPixmap(): reserves room for a width x height pixmap and hands out the page memory
+    // to write it into, then commit() marks it dirty. The rect starts out cleared. `pixels` is only valid until
+    // something else is added to the atlas.
+    struct Reservation
+    {
+        unsigned char *pixels; // top left of the rect
+        int stride;            // in bytes
+        PackedPixmap packedPixmap;
+
+    private:
+        friend class TextureAtlas;
+        PageTexture *entry = nullptr;
+    };
+    std::optional<Reservation> reserve(int width, int height);
+    void commit(const Reservation &reservation, UploadPriority priority = UploadPriority::High);
+
+    // Rebuilds the pages with only the given pixmaps, which are updated in place. Everything else is dropped and
+    // the new pages are uploaded right away, so this must not be called while drawing. Returns the indices of the
+    // pixmaps that couldn't be placed again: they refer to a destroyed texture and must be dropped by the caller.
+    std::vector<std::size_t> repack(const std::vector<PackedPixmap *> &pixmaps);
 
     int pageCount() const;
+    int textureCount() const;
     const TextureAtlasPage &page(int index) const;
 
+    // For persisting the atlas: pages are added back read-only, placements are a page index and a rect in pixels.
+    int restorePage(Pixmap pixmap);
+    std::optional<std::pair<int, RectI>> locate(const PackedPixmap &pixmap) const;
+    PackedPixmap packedPixmap(int pageIndex, const RectI &rect) const;
+
 private:
+    struct ChannelGroup
+    {
+        ChannelGroup(int width, int height);
+        Pixmap pixmap; // RGBA, one page per channel
+        LazyTexture texture;
+    };
     struct PageTexture
     {
-        PageTexture(int width, int height, PixelType pixelType);
+        PageTexture(int width, int height, PixelType pixelType, TextureAtlasPage::Packer packer);
+        explicit PageTexture(Pixmap pixmap);
         TextureAtlasPage page;
-        LazyTexture texture;
+        std::unique_ptr<LazyTexture> ownTexture; // null when the page lives in a channel group
+        LazyTexture *texture = nullptr;
+        ChannelGroup *group = nullptr;
+        int channel = 0;
+    };
+    struct Placement
+    {
+        PageTexture *entry;
+        RectI rect;
     };
+    std::optional<Placement> insert(const Pixmap &pixmap);
+    std::optional<Placement> reserveRect(int width, int height);
+    PackedPixmap packedPixmap(const Placement &placement) const;
+    PageTexture *addPage(std::unique_ptr<PageTexture> page);
+    bool canGrow(const PageTexture &entry) const;
+    void grow(PageTexture &entry);
+    void markDirty(PageTexture &entry, const RectI &rect, UploadPriority priority);
+
     int m_pageWidth;
     int m_pageHeight;
+    glm::ivec2 m_initialPageSize;
     PixelType m_pixelType;
+    TextureAtlasPage::Packer m_packer;
+    bool m_channelPacking = false;
     std::vector<std::unique_ptr<PageTexture>> m_pages;
+    std::vector<std::unique_ptr<ChannelGroup>> m_channelGroups;
 };
@@ -1,23 +1,69 @@
 #include "textureatlaspage.h"
 
 #include "pixmap.h"
+#include "trace.h"
 
+#include <algorithm>
 #include <cassert>
 
-struct TextureAtlasPage::Node
+namespace
 {
-    struct Rect
+struct PackerRect
+{
+    int x, y;
+    int width, height;
+
+    int right() const { return x + width; }
+    int bottom() const { return y + height; }
+
+    bool contains(const PackerRect &other) const
     {
-        int x, y;
-        int width, height;
+        return other.x >= x && other.y >= y && other.right() <= right() && other.bottom() <= bottom();
+    }
+
+    bool intersects(const PackerRect &other) const
+    {
+        return other.x < right() && x < other.right() && other.y < bottom() && y < other.bottom();
+    }
+};
+} // namespace
+
+class TextureAtlasPage::RectPacker
+{
+public:
+    virtual ~RectPacker() = default;
+
+    virtual std::optional<PackerRect> insert(int width, int height) = 0;
+    // The bin grew to the right and down, what was placed stays where it is.
+    virtual void grow(int width, int height) = 0;
+};
+
+namespace
+{
+
+class GuillotinePacker : public TextureAtlasPage::RectPacker
+{
+public:
+    GuillotinePacker(int width, int height)
+        : m_tree(std::make_unique<Node>(Node{{0, 0, width, height}}))
+    {
+    }
+
+    std::optional<PackerRect> insert(int width, int height) override { return m_tree->insert(width, height); }
+    void grow(int width, int height) override;
+
+private:
+    struct Node
+    {
+        PackerRect rect;
+        std::unique_ptr<Node> left, right;
+        bool used;
+        std::optional<PackerRect> insert(int width, int height);
     };
-    Rect rect;
-    std::unique_ptr<Node> left, right;
-    bool used;
-    std::optional<Rect> insert(int width, int height);
+    std::unique_ptr<Node> m_tree;
 };
 
-std::optional<TextureAtlasPage::Node::Rect> TextureAtlasPage::Node::insert(int width, int height)
+std::optional<PackerRect> GuillotinePacker::Node::insert(int width, int height)
 {
     if (used)
     {
@@ -72,9 +118,368 @@ std::optional<TextureAtlasPage::Node::Rect> TextureAtlasPage::Node::insert(int w
     }
 }
 
-TextureAtlasPage::TextureAtlasPage(int width, int height, PixelType pixelType)
+void GuillotinePacker::grow(int width, int height)
+{
+    // the old tree, a strip to its right and one below everything
+    const auto old = m_tree->rect;
+    auto top = std::make_unique<Node>(Node{{0, 0, width, old.height}});
+    top->left = std::move(m_tree);
+    top->right = std::make_unique<Node>(Node{{old.width, 0, width - old.width, old.height}});
+    m_tree = std::make_unique<Node>(Node{{0, 0, width, height}});
+    m_tree->left = std::move(top);
+    m_tree->right = std::make_unique<Node>(Node{{0, old.height, width, height - old.height}});
+}
+
+// Free list of disjoint rectangles, best area fit, split along the shorter leftover axis. Used as the waste map of
+// the skyline packer.
+class FreeList
+{
+public:
+    void add(const PackerRect &rect)
+    {
+        if (rect.width > 0 && rect.height > 0)
+            m_rects.push_back(rect);
+    }
+
+    std::optional<PackerRect> insert(int width, int height)
+    {
+        auto best = m_rects.end();
+        int bestArea = 0;
+        for (auto it = m_rects.begin(); it != m_rects.end(); ++it)
+        {
+            if (width > it->width || height > it->height)
+                continue;
+            const int area = it->width * it->height;
+            if (best == m_rects.end() || area < bestArea)
+            {
+                best = it;
+                bestArea = area;
+            }
+        }
+        if (best == m_rects.end())
+            return std::nullopt;
+
+        const auto free = *best;
+        *best = m_rects.back();
+        m_rects.pop_back();
+
+        const PackerRect placed{free.x, free.y, width, height};
+        const int leftoverWidth = free.width - width;
+        const int leftoverHeight = free.height - height;
+        if (leftoverWidth < leftoverHeight)
+        {
+            add({free.x + width, free.y, leftoverWidth, height});
+            add({free.x, free.y + height, free.width, leftoverHeight});
+        }
+        else
+        {
+            add({free.x + width, free.y, leftoverWidth, free.height});
+            add({free.x, free.y + height, width, leftoverHeight});
+        }
+        return placed;
+    }
+
+private:
+    std::vector<PackerRect> m_rects;
+};
+
+class SkylinePacker : public TextureAtlasPage::RectPacker
+{
+public:
+    SkylinePacker(int width, int height)
+        : m_width(width)
+        , m_height(height)
+        , m_skyline{{0, 0, width}}
+    {
+    }
+
+    std::optional<PackerRect> insert(int width, int height) override;
+    void grow(int width, int height) override;
+
+private:
+    struct Segment
+    {
+        int x, y;
+        int width;
+    };
+
+    std::optional<int> fitY(std::size_t index, int width, int height) const;
+    void addToWasteMap(std::size_t index, const PackerRect &rect);
+    void addSegment(std::size_t index, const PackerRect &rect);
+
+    int m_width;
+    int m_height;
+    std::vector<Segment> m_skyline;
+    FreeList m_wasteMap;
+};
+
+std::optional<PackerRect> SkylinePacker::insert(int width, int height)
+{
+    if (auto rect = m_wasteMap.insert(width, height))
+        return rect;
+
+    // bottom-left: lowest resulting top edge, then narrowest segment
+    std::optional<std::size_t> bestIndex;
+    int bestBottom = 0;
+    int bestWidth = 0;
+    for (std::size_t i = 0; i < m_skyline.size(); ++i)
+    {
+        const auto y = fitY(i, width, height);
+        if (!y)
+            continue;
+        const int bottom = *y + height;
+        if (!bestIndex || bottom < bestBottom || (bottom == bestBottom && m_skyline[i].width < bestWidth))
+        {
+            bestIndex = i;
+            bestBottom = bottom;
+            bestWidth = m_skyline[i].width;
+        }
+    }
+    if (!bestIndex)
+        return std::nullopt;
+
+    const PackerRect rect{m_skyline[*bestIndex].x, bestBottom - height, width, height};
+    addToWasteMap(*bestIndex, rect);
+    addSegment(*bestIndex, rect);
+    return rect;
+}
+
+void SkylinePacker::grow(int width, int height)
+{
+    if (m_skyline.back().y == 0)
+        m_skyline.back().width += width - m_width;
+    else
+        m_skyline.push_back(Segment{m_width, 0, width - m_width});
+    m_width = width;
+    m_height = height;
+}
+
+// y at which a width x height rect starting at segment `index` rests on the skyline, if it fits
+std::optional<int> SkylinePacker::fitY(std::size_t index, int width, int height) const
+{
+    const int x = m_skyline[index].x;
+    if (x + width > m_width)
+        return std::nullopt;
+    int y = 0;
+    int remaining = width;
+    for (auto i = index; remaining > 0; ++i)
+    {
+        assert(i < m_skyline.size());
+        y = std::max(y, m_skyline[i].y);
+        if (y + height > m_height)
+            return std::nullopt;
+        remaining -= m_skyline[i].width;
+    }
+    return y;
+}
+
+void SkylinePacker::addToWasteMap(std::size_t index, const PackerRect &rect)
+{
+    // the gaps between the skyline and the bottom of the new rect become unreachable for the skyline
+    for (auto i = index; i < m_skyline.size() && m_skyline[i].x < rect.right(); ++i)
+    {
+        const auto &segment = m_skyline[i];
+        const int left = segment.x;
+        const int right = std::min(segment.x + segment.width, rect.right());
+        m_wasteMap.add({left, segment.y, right - left, rect.y - segment.y});
+    }
+}
+
+void SkylinePacker::addSegment(std::size_t index, const PackerRect &rect)
+{
+    m_skyline.insert(m_skyline.begin() + index, Segment{rect.x, rect.bottom(), rect.width});
+
+    // shrink or remove the segments now covered by the new one
+    for (auto i = index + 1; i < m_skyline.size();)
+    {
+        auto &segment = m_skyline[i];
+        const int shrink = rect.right() - segment.x;
+        if (shrink <= 0)
+            break;
+        if (shrink < segment.width)
+        {
+            segment.x += shrink;
+            segment.width -= shrink;
+            break;
+        }
+        m_skyline.erase(m_skyline.begin() + i);
+    }
+
+    // merge neighbours at the same height
+    for (std::size_t i = 0; i + 1 < m_skyline.size();)
+    {
+        if (m_skyline[i].y == m_skyline[i + 1].y)
+        {
+            m_skyline[i].width += m_skyline[i + 1].width;
+            m_skyline.erase(m_skyline.begin() + i + 1);
+        }
+        else
+        {
+            ++i;
+        }
+    }
+}
+
+class MaxRectsPacker : public TextureAtlasPage::RectPacker
+{
+public:
+    MaxRectsPacker(int width, int height)
+        : m_width(width)
+        , m_height(height)
+        , m_freeRects{{0, 0, width, height}}
+    {
+    }
+
+    std::optional<PackerRect> insert(int width, int height) override;
+    void grow(int width, int height) override;
+
+private:
+    void splitFreeRects(const PackerRect &placed);
+    void pruneFreeRects();
+
+    int m_width;
+    int m_height;
+    std::vector<PackerRect> m_freeRects;
+    std::vector<PackerRect> m_newRects;
+};
+
+std::optional<PackerRect> MaxRectsPacker::insert(int width, int height)
+{
+    // best short side fit
+    std::optional<PackerRect> best;
+    int bestShortSide = 0;
+    int bestLongSide = 0;
+    for (const auto &free : m_freeRects)
+    {
+        if (width > free.width || height > free.height)
+            continue;
+        const int leftoverWidth = free.width - width;
+        const int leftoverHeight = free.height - height;
+        const int shortSide = std::min(leftoverWidth, leftoverHeight);
+        const int longSide = std::max(leftoverWidth, leftoverHeight);
+        if (!best || shortSide < bestShortSide || (shortSide == bestShortSide && longSide < bestLongSide))
+        {
+            best = PackerRect{free.x, free.y, width, height};
+            bestShortSide = shortSide;
+            bestLongSide = longSide;
+        }
+    }
+    if (!best)
+        return std::nullopt;
+
+    splitFreeRects(*best);
+    pruneFreeRects();
+    return best;
+}
+
+void MaxRectsPacker::grow(int width, int height)
+{
+    // free rects on the old edges extend into the new space, which is entirely free
+    for (auto &free : m_freeRects)
+    {
+        if (free.right() == m_width)
+            free.width = width - free.x;
+        if (free.bottom() == m_height)
+            free.height = height - free.y;
+    }
+    m_newRects = {{m_width, 0, width - m_width, height}, {0, m_height, width, height - m_height}};
+    m_width = width;
+    m_height = height;
+
+    // the extended rects may now be inside the new ones, or inside each other
+    m_freeRects.insert(m_freeRects.end(), m_newRects.begin(), m_newRects.end());
+    std::vector<PackerRect> maximal;
+    for (std::size_t i = 0; i < m_freeRects.size(); ++i)
+    {
+        const auto &rect = m_freeRects[i];
+        if (rect.width <= 0 || rect.height <= 0)
+            continue;
+        const bool contained = std::any_of(m_freeRects.begin(), m_freeRects.end(), [&](const PackerRect &other) {
+            const auto j = static_cast<std::size_t>(&other - m_freeRects.data());
+            return j != i && other.contains(rect) && (j < i || !rect.contains(other));
+        });
+        if (!contained)
+            maximal.push_back(rect);
+    }
+    m_freeRects = std::move(maximal);
+}
+
+void MaxRectsPacker::splitFreeRects(const PackerRect &placed)
+{
+    m_newRects.clear();
+    for (std::size_t i = 0; i < m_freeRects.size();)
+    {
+        const auto free = m_freeRects[i];
+        if (!free.intersects(placed))
+        {
+            ++i;
+            continue;
+        }
+        if (placed.x > free.x)
+            m_newRects.push_back({free.x, free.y, placed.x - free.x, free.height});
+        if (placed.right() < free.right())
+            m_newRects.push_back({placed.right(), free.y, free.right() - placed.right(), free.height});
+        if (placed.y > free.y)
+            m_newRects.push_back({free.x, free.y, free.width, placed.y - free.y});
+        if (placed.bottom() < free.bottom())
+            m_newRects.push_back({free.x, placed.bottom(), free.width, free.bottom() - placed.bottom()});
+        m_freeRects[i] = m_freeRects.back();
+        m_freeRects.pop_back();
+    }
+}
+
+void MaxRectsPacker::pruneFreeRects()
+{
+    // The remaining free rects don't contain each other, and none of them can be inside a new one (each new rect
+    // lies within a free rect that was just removed), so only the new rects need checking.
+    const auto count = m_freeRects.size();
+    const auto contained = [this, count](std::size_t index) {
+        const auto &rect = m_newRects[index];
+        for (std::size_t i = 0; i < count; ++i)
+        {
+            if (m_freeRects[i].contains(rect))
+                return true;
+        }
+        for (std::size_t i = 0; i < m_newRects.size(); ++i)
+        {
+            // of two equal rects keep the first one
+            if (i != index && m_newRects[i].contains(rect) && (i < index || !rect.contains(m_newRects[i])))
+                return true;
+        }
+        return false;
+    };
+    for (std::size_t i = 0; i < m_newRects.size(); ++i)
+    {
+        if (!contained(i))
+            m_freeRects.push_back(m_newRects[i]);
+    }
+}
+
+std::unique_ptr<TextureAtlasPage::RectPacker> makePacker(TextureAtlasPage::Packer packer, int width, int height)
+{
+    switch (packer)
+    {
+    case TextureAtlasPage::Packer::Guillotine:
+        return std::make_unique<GuillotinePacker>(width, height);
+    case TextureAtlasPage::Packer::Skyline:
+    default:
+        return std::make_unique<SkylinePacker>(width, height);
+    case TextureAtlasPage::Packer::MaxRects:
+        return std::make_unique<MaxRectsPacker>(width, height);
+    }
+}
+
+} // namespace
+
+TextureAtlasPage::TextureAtlasPage(int width, int height, PixelType pixelType, Packer packer)
     : m_pixmap(width, height, pixelType)
-    , m_tree(std::make_unique<Node>(Node{{0, 0, width, height}}))
+    , m_packer(makePacker(packer, width, height))
+{
+}
+
+TextureAtlasPage::TextureAtlasPage(Pixmap pixmap)
+    : m_pixmap(std::move(pixmap))
+    , m_usedArea(static_cast<std::size_t>(m_pixmap.width) * m_pixmap.height)
 {
 }
 
@@ -85,27 +490,46 @@ const Pixmap *TextureAtlasPage::pixmap() const
     return &m_pixmap;
 }
 
-std::optional<RectF> TextureAtlasPage::insert(const Pixmap &pixmap)
+float TextureAtlasPage::occupancy() const
+{
+    return static_cast<float>(m_usedArea) / (m_pixmap.width * m_pixmap.height);
+}
+
+bool TextureAtlasPage::mightFit(int width, int height) const
 {
-    constexpr auto Margin = 1;
+    if (!m_packer)
+        return false;
+    const auto size = glm::ivec2(width + 2 * Margin, height + 2 * Margin);
+    if (m_packedArea + size.x * size.y > static_cast<std::size_t>(m_pixmap.width) * m_pixmap.height)
+        return false;
+    return std::none_of(m_failedSizes.begin(), m_failedSizes.end(),
+                        [&size](const glm::ivec2 &failed) { return size.x >= failed.x && size.y >= failed.y; });
+}
 
+std::optional<RectI> TextureAtlasPage::insert(const Pixmap &pixmap)
+{
     if (pixmap.pixelType != m_pixmap.pixelType)
-    {
         return std::nullopt;
-    }
 
-    auto rect = m_tree->insert(pixmap.width + 2 * Margin, pixmap.height + 2 * Margin);
+    const auto rect = reserve(pixmap.width, pixmap.height);
     if (!rect)
-    {
         return std::nullopt;
-    }
+
+    write(rect->min, pixmap);
+    return rect;
+}
+
+void TextureAtlasPage::write(const glm::ivec2 &position, const Pixmap &pixmap)
+{
+    assert(pixmap.pixelType == m_pixmap.pixelType);
+    assert(position.x + pixmap.width <= m_pixmap.width && position.y + pixmap.height <= m_pixmap.height);
 
     const auto pixelSize = pixelSizeInBytes(m_pixmap.pixelType);
 
     const unsigned char *src = pixmap.pixels.data();
     const auto srcSpan = pixmap.width * pixelSize;
 
-    unsigned char *dest = m_pixmap.pixels.data() + ((rect->y + Margin) * m_pixmap.width + rect->x + Margin) * pixelSize;
+    unsigned char *dest = pixelData(position);
     const auto destSpan = m_pixmap.width * pixelSize;
 
     for (int i = 0; i < pixmap.height; ++i)
@@ -114,11 +538,61 @@ std::optional<RectF> TextureAtlasPage::insert(const Pixmap &pixmap)
         src += srcSpan;
         dest += destSpan;
     }
+}
+
+std::optional<RectI> TextureAtlasPage::reserve(int width, int height)
+{
+    TRACE_ZONE("TextureAtlasPage::reserve");
+
+    if (!mightFit(width, height))
+        return std::nullopt;
+
+    const auto size = glm::ivec2(width + 2 * Margin, height + 2 * Margin);
+    auto rect = m_packer->insert(size.x, size.y);
+    if (!rect)
+    {
+        constexpr auto MaxFailedSizes = 8;
+        std::erase_if(m_failedSizes,
+                      [&size](const glm::ivec2 &failed) { return failed.x >= size.x && failed.y >= size.y; });
+        if (m_failedSizes.size() == MaxFailedSizes)
+            m_failedSizes.erase(m_failedSizes.begin());
+        m_failedSizes.push_back(size);
+        return std::nullopt;
+    }
+    m_packedArea += size.x * size.y;
+    m_usedArea += width * height;
+
+    const auto min = glm::ivec2(rect->x + Margin, rect->y + Margin);
+    return RectI{min, min + glm::ivec2(width, height)};
+}
 
-    const auto textureSize = glm::vec2(m_pixmap.width, m_pixmap.height);
-    const auto uvMin = glm::vec2(rect->x + Margin, rect->y + Margin) / textureSize;
-    const auto duv = glm::vec2(rect->width - 2 * Margin, rect->height - 2 * Margin) / textureSize;
-    const auto uvMax = uvMin + duv;
+unsigned char *TextureAtlasPage::pixelData(const glm::ivec2 &position)
+{
+    const auto pixelSize = pixelSizeInBytes(m_pixmap.pixelType);
+    return m_pixmap.pixels.data() + (position.y * m_pixmap.width + position.x) * pixelSize;
+}
+
+bool TextureAtlasPage::canGrow() const
+{
+    return m_packer != nullptr;
+}
+
+void TextureAtlasPage::grow(int width, int height)
+{
+    TRACE_ZONE("TextureAtlasPage::grow");
+
+    assert(canGrow() && width >= m_pixmap.width && height >= m_pixmap.height);
+
+    Pixmap pixmap(width, height, m_pixmap.pixelType);
+    const auto pixelSize = pixelSizeInBytes(m_pixmap.pixelType);
+    const auto srcSpan = m_pixmap.width * pixelSize;
+    for (int i = 0; i < m_pixmap.height; ++i)
+    {
+        const auto *src = m_pixmap.pixels.data() + i * srcSpan;
+        std::copy(src, src + srcSpan, pixmap.pixels.data() + i * width * pixelSize);
+    }
+    m_pixmap = std::move(pixmap);
 
-    return RectF{uvMin, uvMax};
+    m_packer->grow(width, height);
+    m_failedSizes.clear();
 }
@@ -14,15 +14,50 @@
 class TextureAtlasPage : private NonCopyable
 {
 public:
-    TextureAtlasPage(int width, int height, PixelType pixelType);
+    enum class Packer
+    {
+        Guillotine, // binary tree of splits
+        Skyline,    // bottom-left skyline, with a waste map for the space left under it
+        MaxRects,   // maximal free rectangles, best short side fit
+    };
+
+    TextureAtlasPage(int width, int height, PixelType pixelType, Packer packer = Packer::Skyline);
+    // A page saved by an earlier run. The packer state isn't kept, so nothing more can be inserted.
+    explicit TextureAtlasPage(Pixmap pixmap);
     ~TextureAtlasPage();
 
+    static constexpr auto Margin = 1; // cleared border around each inserted pixmap
+
     const Pixmap *pixmap() const;
 
-    std::optional<RectF> insert(const Pixmap &pixmap);
+    // Returns where the pixmap was placed, in pixels. The rect grown by Margin on each side was written.
+    std::optional<RectI> insert(const Pixmap &pixmap);
+
+    // Like insert(), but leaves the rect for the caller to write through pixelData(). Space is never reused, so the
+    // rect and its margin are cleared.
+    std::optional<RectI> reserve(int width, int height);
+    unsigned char *pixelData(const glm::ivec2 &position);
+    // Copies the pixmap into a reserved rect starting at `position`.
+    void write(const glm::ivec2 &position, const Pixmap &pixmap);
+
+    // Enlarges the page in place, keeping everything where it was. Restored pages can't grow.
+    bool canGrow() const;
+    void grow(int width, int height);
+
+    std::size_t usedArea() const { return m_usedArea; } // in pixels, not counting margins
+    float occupancy() const;
+
+    // Conservative and O(1)-ish: false means the pixmap certainly doesn't fit, true that it might.
+    bool mightFit(int width, int height) const;
+
+    class RectPacker; // implementation detail, one per Packer
 
 private:
     Pixmap m_pixmap;
-    struct Node;
-    std::unique_ptr<Node> m_tree;
+    std::unique_ptr<RectPacker> m_packer;
+    std::size_t m_usedArea = 0;
+    std::size_t m_packedArea = 0; // including margins
+    // Smallest sizes that failed to fit, none larger than another in both dimensions. Space is never freed, so
+    // anything at least as large as one of these fails too.
+    std::vector<glm::ivec2> m_failedSizes;
 };
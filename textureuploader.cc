@@ -0,0 +1,119 @@
+#include "textureuploader.h"
+
+#include "lazytexture.h"
+#include "pixeluploadring.h"
+#include "pixmap.h"
+#include "system.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace
+{
+std::size_t regionSize(const LazyTexture *texture, const LazyTexture::DirtyRegion &region)
+{
+    return region.rect.width() * region.rect.height() * pixelSizeInBytes(texture->pixmap()->pixelType);
+}
+} // namespace
+
+TextureUploader::TextureUploader()
+{
+    if (gl::PixelUploadRing::isSupported())
+        m_ring = std::make_unique<gl::PixelUploadRing>();
+}
+
+TextureUploader::~TextureUploader() = default;
+
+void TextureUploader::schedule(LazyTexture *texture)
+{
+    if (std::find(m_textures.begin(), m_textures.end(), texture) == m_textures.end())
+        m_textures.push_back(texture);
+}
+
+void TextureUploader::cancel(LazyTexture *texture)
+{
+    std::erase(m_textures, texture);
+}
+
+void TextureUploader::flush(LazyTexture *texture)
+{
+    // upload() removes the region from the texture's list
+    const auto regions = texture->dirtyRegions();
+    for (const auto &region : regions)
+        texture->upload(region.rect, m_ring.get());
+    cancel(texture);
+}
+
+void TextureUploader::flush(LazyTexture *texture, const RectI &rect)
+{
+    const auto regions = texture->dirtyRegions();
+    for (const auto &region : regions)
+    {
+        if (region.rect.intersects(rect))
+            texture->upload(region.rect, m_ring.get());
+    }
+    if (texture->dirtyRegions().empty())
+        cancel(texture);
+}
+
+void TextureUploader::uploadPending()
+{
+    if (m_textures.empty())
+    {
+        // uploads from flush() may have used the ring
+        if (m_ring)
+            m_ring->endFrame();
+        return;
+    }
+
+    TRACE_ZONE("TextureUploader::uploadPending");
+
+    const auto start = std::chrono::steady_clock::now();
+
+    struct Pending
+    {
+        LazyTexture *texture;
+        LazyTexture::DirtyRegion region;
+    };
+    std::vector<Pending> pending;
+    for (auto *texture : m_textures)
+    {
+        for (const auto &region : texture->dirtyRegions())
+            pending.push_back({texture, region});
+    }
+    std::sort(pending.begin(), pending.end(), [](const Pending &lhs, const Pending &rhs) {
+        if (lhs.region.priority != rhs.region.priority)
+            return lhs.region.priority > rhs.region.priority;
+        return lhs.region.sequence < rhs.region.sequence;
+    });
+
+    // a region larger than the whole budget still goes out on its own
+    std::size_t bytes = 0;
+    for (const auto &[texture, region] : pending)
+    {
+        const auto size = regionSize(texture, region);
+        if (bytes > 0 && bytes + size > m_byteBudget)
+            break;
+        bytes += texture->upload(region.rect, m_ring.get());
+    }
+
+    std::erase_if(m_textures, [](const LazyTexture *texture) { return texture->dirtyRegions().empty(); });
+    if (m_ring)
+        m_ring->endFrame();
+
+    auto &stats = System::instance()->frameStats();
+    stats.uploadTime += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    stats.bytesPendingUpload = bytesPending();
+}
+
+std::size_t TextureUploader::bytesPending() const
+{
+    std::size_t bytes = 0;
+    for (const auto *texture : m_textures)
+    {
+        for (const auto &region : texture->dirtyRegions())
+            bytes += regionSize(texture, region);
+    }
+    return bytes;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "noncopyable.h"
+#include "util.h"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+class LazyTexture;
+
+namespace gl
+{
+class PixelUploadRing;
+}
+
+// Uploads the dirty regions of lazy textures once per frame, before anything is drawn, up to a byte budget. High
+// priority regions go first, then oldest first. Whatever doesn't fit waits for the next frame. Uploads are staged
+// through a ring of pixel buffers where supported.
+class TextureUploader : private NonCopyable
+{
+public:
+    static constexpr std::size_t DefaultByteBudget = 1024 * 1024;
+
+    TextureUploader();
+    ~TextureUploader();
+
+    void setByteBudget(std::size_t bytes) { m_byteBudget = bytes; }
+    std::size_t byteBudget() const { return m_byteBudget; }
+
+    void schedule(LazyTexture *texture);
+    void cancel(LazyTexture *texture);
+
+    // Uploads all of the texture's dirty regions now, ignoring the budget.
+    void flush(LazyTexture *texture);
+    // Same for the dirty regions that overlap `rect`, e.g. because they're about to be drawn.
+    void flush(LazyTexture *texture, const RectI &rect);
+
+    void uploadPending();
+
+    std::size_t bytesPending() const;
+
+private:
+    std::size_t m_byteBudget = DefaultByteBudget;
+    std::unique_ptr<gl::PixelUploadRing> m_ring;
+    std::vector<LazyTexture *> m_textures; // with dirty regions
+};
@@ -0,0 +1,225 @@
+#include "trace.h"
+
+#include "log.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace trace
+{
+
+namespace
+{
+using Clock = std::chrono::steady_clock;
+
+const Clock::time_point StartTime = Clock::now();
+
+std::int64_t now()
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - StartTime).count();
+}
+
+struct Event
+{
+    const char *name;
+    std::int64_t start; // in ns
+    std::int64_t duration;
+};
+
+// A ring of the newest events, written only by the owning thread so that recording never takes a lock. Event n
+// lives in slot n % Capacity. A reader copies the events up to `count` (published with release semantics), then
+// keeps those that no write has started on since, seqlock style: `started` is bumped before a slot is overwritten.
+struct ThreadBuffer
+{
+    static constexpr std::size_t Capacity = 1 << 16;
+
+    struct Slot
+    {
+        std::atomic<const char *> name;
+        std::atomic<std::int64_t> start;
+        std::atomic<std::int64_t> duration;
+    };
+
+    explicit ThreadBuffer(int threadId)
+        : threadId(threadId)
+        , slots(new Slot[Capacity])
+    {
+    }
+
+    void push(const Event &event)
+    {
+        const auto index = count.load(std::memory_order_relaxed);
+        started.store(index + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        auto &slot = slots[index % Capacity];
+        slot.name.store(event.name, std::memory_order_relaxed);
+        slot.start.store(event.start, std::memory_order_relaxed);
+        slot.duration.store(event.duration, std::memory_order_relaxed);
+        count.store(index + 1, std::memory_order_release);
+    }
+
+    // The newest events, oldest first. Returns how many events were recorded in total.
+    std::size_t snapshot(std::vector<Event> &events) const
+    {
+        const auto end = count.load(std::memory_order_acquire);
+        const auto begin = end > Capacity ? end - Capacity : 0;
+        events.clear();
+        events.reserve(end - begin);
+        for (auto i = begin; i < end; ++i)
+        {
+            const auto &slot = slots[i % Capacity];
+            events.push_back(Event{slot.name.load(std::memory_order_relaxed),
+                                   slot.start.load(std::memory_order_relaxed),
+                                   slot.duration.load(std::memory_order_relaxed)});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        // the oldest ones may have been overwritten while they were copied
+        const auto overwritten = started.load(std::memory_order_relaxed);
+        if (overwritten > begin + Capacity)
+            events.erase(events.begin(), events.begin() + std::min(overwritten - Capacity - begin, events.size()));
+        return end;
+    }
+
+    int threadId;
+    std::unique_ptr<Slot[]> slots;
+    std::atomic<std::size_t> count = 0;   // events recorded
+    std::atomic<std::size_t> started = 0; // events whose recording has begun
+};
+
+struct Registry
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::string dumpPath;
+};
+
+std::atomic<bool> s_enabled = false;
+
+Registry &registry()
+{
+    static Registry registry;
+    return registry;
+}
+
+ThreadBuffer *threadBuffer()
+{
+    // buffers are owned by the registry so events of finished threads survive until the dump
+    thread_local ThreadBuffer *buffer = [] {
+        auto &r = registry();
+        std::lock_guard lock(r.mutex);
+        r.buffers.push_back(std::make_unique<ThreadBuffer>(static_cast<int>(r.buffers.size()) + 1));
+        return r.buffers.back().get();
+    }();
+    return buffer;
+}
+
+void writeEscaped(std::FILE *file, const char *s)
+{
+    for (; *s; ++s)
+    {
+        if (*s == '"' || *s == '\\')
+            std::fputc('\\', file);
+        std::fputc(*s, file);
+    }
+}
+
+void dumpAtExit()
+{
+    auto &r = registry();
+    std::string path;
+    {
+        std::lock_guard lock(r.mutex);
+        path = r.dumpPath;
+    }
+    if (!path.empty())
+        writeJson(path);
+}
+} // namespace
+
+void setEnabled(bool enabled)
+{
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool isEnabled()
+{
+    return s_enabled.load(std::memory_order_relaxed);
+}
+
+bool writeJson(const std::string &path)
+{
+    std::FILE *file = std::fopen(path.c_str(), "w");
+    if (!file)
+    {
+        log("Failed to open trace file %s\n", path.c_str());
+        return false;
+    }
+
+    auto &r = registry();
+    std::lock_guard lock(r.mutex);
+
+    std::fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    bool first = true;
+    std::size_t eventCount = 0;
+    std::vector<Event> events;
+    for (const auto &buffer : r.buffers)
+    {
+        const auto recorded = buffer->snapshot(events);
+        for (const auto &event : events)
+        {
+            if (!first)
+                std::fprintf(file, ",\n");
+            first = false;
+            std::fprintf(file, "{\"name\":\"");
+            writeEscaped(file, event.name);
+            // timestamps are in microseconds
+            std::fprintf(file, "\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}", buffer->threadId,
+                         1e-3 * event.start, 1e-3 * event.duration);
+        }
+        eventCount += events.size();
+        if (recorded > events.size())
+            log("Trace buffer for thread %d wrapped, kept the newest %zu of %zu events\n", buffer->threadId,
+                events.size(), recorded);
+    }
+    std::fprintf(file, "\n]}\n");
+    std::fclose(file);
+
+    log("Wrote %zu trace events to %s\n", eventCount, path.c_str());
+
+    return true;
+}
+
+void setDumpOnExit(const std::string &path)
+{
+    auto &r = registry();
+    bool registered;
+    {
+        std::lock_guard lock(r.mutex);
+        registered = !r.dumpPath.empty();
+        r.dumpPath = path;
+    }
+    if (!registered)
+        std::atexit(dumpAtExit);
+}
+
+Zone::Zone(const char *name)
+    : m_name(name)
+    , m_start(isEnabled() ? now() : -1)
+{
+}
+
+Zone::~Zone()
+{
+    if (m_start < 0)
+        return;
+    const auto end = now();
+    threadBuffer()->push(Event{m_name, m_start, end - m_start});
+}
+
+} // namespace trace
@@ -0,0 +1,41 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <cstdint>
+#include <string>
+
+// scoped zone markers exported as Chrome trace_event JSON (viewable in Perfetto or chrome://tracing)
+//
+// Each thread keeps its newest 65536 events, older ones are overwritten.
+
+namespace trace
+{
+
+void setEnabled(bool enabled);
+bool isEnabled();
+
+// Safe to call at any time, while other threads record.
+bool writeJson(const std::string &path);
+void setDumpOnExit(const std::string &path);
+
+class Zone : private NonCopyable
+{
+public:
+    explicit Zone(const char *name);
+    ~Zone();
+
+private:
+    const char *m_name;
+    std::int64_t m_start;
+};
+
+} // namespace trace
+
+#ifdef ENABLE_TRACING
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_ZONE(name) trace::Zone TRACE_CONCAT(traceZone, __LINE__)(name)
+#else
+#define TRACE_ZONE(name)
+#endif
@@ -0,0 +1,52 @@
+#include "workerpool.h"
+
+#include "trace.h"
+
+#include <algorithm>
+
+WorkerPool::WorkerPool(int threadCount)
+{
+    if (threadCount <= 0)
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+    m_threads.reserve(threadCount);
+    for (int i = 0; i < threadCount; ++i)
+        m_threads.emplace_back([this] { run(); });
+}
+
+WorkerPool::~WorkerPool()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_jobAvailable.notify_all();
+    for (auto &thread : m_threads)
+        thread.join();
+}
+
+void WorkerPool::post(std::function<void()> job)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_jobs.push_back(std::move(job));
+    }
+    m_jobAvailable.notify_one();
+}
+
+void WorkerPool::run()
+{
+    for (;;)
+    {
+        std::function<void()> job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_jobAvailable.wait(lock, [this] { return m_stopping || !m_jobs.empty(); });
+            if (m_jobs.empty())
+                return;
+            job = std::move(m_jobs.front());
+            m_jobs.pop_front();
+        }
+        TRACE_ZONE("WorkerPool::job");
+        job();
+    }
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "noncopyable.h"
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Runs jobs on a fixed set of background threads, in the order they were posted. Jobs still queued when the pool
+// is destroyed are run before the threads exit.
+class WorkerPool : private NonCopyable
+{
+public:
+    // 0 picks one less than the number of cores, at least one
+    explicit WorkerPool(int threadCount = 0);
+    ~WorkerPool();
+
+    int threadCount() const { return static_cast<int>(m_threads.size()); }
+
+    void post(std::function<void()> job);
+
+private:
+    void run();
+
+    std::mutex m_mutex;
+    std::condition_variable m_jobAvailable;
+    std::deque<std::function<void()>> m_jobs;
+    bool m_stopping = false;
+    std::vector<std::thread> m_threads;
+};